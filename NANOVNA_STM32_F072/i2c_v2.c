@@ -33,18 +33,36 @@ void i2c_start(void) {
   i2c_set_timings(STM32_I2C_INIT_T);
 }
 
+#ifdef __USE_I2C_STAT__
+// Use system tick for measure I2C wait time (M0 core not have cycle counter)
+#define I2C_STAT_GET_TIME()     chVTGetSystemTimeX()
+#define I2C_STAT_TIME_TO_US(t)  ST2US(t)
+i2c_stat_t i2c_stat;
+#define I2C_STAT_BEGIN          systime_t _stat_time = I2C_STAT_GET_TIME();
+#define I2C_STAT_END            {i2c_stat.wait+= I2C_STAT_GET_TIME() - _stat_time;}
+#define I2C_STAT_ADD(n)         {i2c_stat.count++; i2c_stat.bytes+= (n);}
+uint32_t i2c_stat_time_us(uint32_t t) {return I2C_STAT_TIME_TO_US(t);}
+#else
+#define I2C_STAT_BEGIN
+#define I2C_STAT_END
+#define I2C_STAT_ADD(n)
+#endif
+
 // I2C TX only (compact version)
 bool i2c_transfer(uint8_t addr, const uint8_t *w, size_t wn)
 {
+  I2C_STAT_ADD(wn);
+  I2C_STAT_BEGIN;
   //if (wn == 0) return false;
   while(VNA_I2C->ISR & I2C_ISR_BUSY); // wait last transaction
   VNA_I2C->CR1|= I2C_CR1_PE;
   VNA_I2C->CR2 = (addr << I2C_CR2_SADD_7BIT_SHIFT) | (wn << I2C_CR2_NBYTES_SHIFT) | I2C_CR2_AUTOEND | I2C_CR2_START;
   do {
     while ((VNA_I2C->ISR & (I2C_ISR_TXE|I2C_ISR_NACKF)) == 0);
-    if (VNA_I2C->ISR & I2C_ISR_NACKF) {VNA_I2C->CR1 = 0; return false;}  // NO ASK error
+    if (VNA_I2C->ISR & I2C_ISR_NACKF) {VNA_I2C->CR1 = 0; I2C_STAT_END; return false;}  // NO ASK error
     VNA_I2C->TXDR = *w++;
   } while (--wn);
+  I2C_STAT_END;
   return true;
 }
 
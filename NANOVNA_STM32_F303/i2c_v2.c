@@ -22,35 +22,141 @@
 #define I2C_CR2_SADD_7BIT_SHIFT         1
 #define I2C_CR2_NBYTES_SHIFT            16
 
-void i2c_set_timings(uint32_t timings) {
-  VNA_I2C->CR1&=~I2C_CR1_PE;
-  VNA_I2C->TIMINGR = timings;
-  VNA_I2C->CR1|= I2C_CR1_PE;
+#ifdef __USE_I2C_STAT__
+// Use CPU cycle counter for measure I2C wait time
+#define I2C_STAT_GET_TIME()     port_rt_get_counter_value()
+#define I2C_STAT_TIME_TO_US(t)  ((t) / (STM32_SYSCLK / 1000000U))
+i2c_stat_t i2c_stat;
+#define I2C_STAT_BEGIN          rtcnt_t _stat_time = I2C_STAT_GET_TIME();
+#define I2C_STAT_END            {i2c_stat.wait+= I2C_STAT_GET_TIME() - _stat_time;}
+#define I2C_STAT_ADD(n)         {i2c_stat.count++; i2c_stat.bytes+= (n);}
+uint32_t i2c_stat_time_us(uint32_t t) {return I2C_STAT_TIME_TO_US(t);}
+#else
+#define I2C_STAT_BEGIN
+#define I2C_STAT_END
+#define I2C_STAT_ADD(n)
+#endif
+
+#ifdef __USE_I2C_DMA__
+/*
+ * I2C TX queue, transfers send by DMA, next transfer started from I2C STOP interrupt
+ * queue data format: addr, len, data ...
+ * DMA can`t access to CCM RAM, so data always copy to queue
+ */
+#define I2C_DMA_TX              DMA1_Channel6      // DMA1 channel 6 use for I2C1 tx
+#define I2C_EV_IRQ_NUMBER       I2C1_EV_IRQn
+#define I2C_EV_IRQ_HANDLER      STM32_I2C1_EVENT_HANDLER
+#define I2C_QUEUE_SIZE          128
+static uint8_t  i2c_queue[I2C_QUEUE_SIZE];
+static uint16_t i2c_rd = 0, i2c_wr = 0;
+static volatile bool i2c_tx_busy = false;
+
+bool i2c_busy(void) {return i2c_tx_busy;}
+
+// Start next transfer from queue (run in locked state)
+static void i2c_queue_start(void) {
+  if (i2c_rd == i2c_wr) { // Queue empty, disable DMA and interrupts
+    i2c_rd = i2c_wr = 0;
+    VNA_I2C->CR1&= ~(I2C_CR1_TXDMAEN | I2C_CR1_STOPIE | I2C_CR1_NACKIE);
+    i2c_tx_busy = false;
+#ifdef I2C_TX_END_HANDLER_FUNC
+    I2C_TX_END_HANDLER_FUNC();
+#endif
+    return;
+  }
+  uint8_t addr = i2c_queue[i2c_rd++];
+  uint8_t len  = i2c_queue[i2c_rd++];
+  i2c_tx_busy = true;
+  dmaChannelSetMemory(I2C_DMA_TX, &i2c_queue[i2c_rd]);
+  dmaChannelSetTransactionSize(I2C_DMA_TX, len);
+  dmaChannelSetMode(I2C_DMA_TX, STM32_DMA_CR_DIR_M2P | STM32_DMA_CR_BYTE | STM32_DMA_CR_MINC | STM32_DMA_CR_EN);
+  i2c_rd+= len;
+  VNA_I2C->CR1|= I2C_CR1_PE | I2C_CR1_TXDMAEN | I2C_CR1_STOPIE | I2C_CR1_NACKIE;
+  VNA_I2C->CR2 = (addr << I2C_CR2_SADD_7BIT_SHIFT) | (len << I2C_CR2_NBYTES_SHIFT) | I2C_CR2_AUTOEND | I2C_CR2_START;
 }
 
-void i2c_start(void) {
-  rccEnableI2C1(FALSE);
-  i2c_set_timings(STM32_I2C_INIT_T);
+OSAL_IRQ_HANDLER(I2C_EV_IRQ_HANDLER) {
+  OSAL_IRQ_PROLOGUE();
+  uint32_t isr = VNA_I2C->ISR;
+  if (isr & I2C_ISR_NACKF)   // NO ASK error, data lost
+    VNA_I2C->ICR = I2C_ICR_NACKCF;
+  if (isr & I2C_ISR_STOPF) {
+    VNA_I2C->ICR = I2C_ICR_STOPCF;
+    dmaChannelDisable(I2C_DMA_TX);
+    i2c_queue_start();
+  }
+  OSAL_IRQ_EPILOGUE();
+}
+
+// Wait all queued transfers
+void i2c_wait(void) {
+  if (!i2c_tx_busy) return;
+  I2C_STAT_BEGIN;
+  while (i2c_tx_busy) __WFI();
+  I2C_STAT_END;
 }
 
+// I2C TX only (queued, not wait transfer end)
+bool i2c_transfer(uint8_t addr, const uint8_t *w, size_t wn)
+{
+  I2C_STAT_ADD(wn);
+  if (wn + 2 > I2C_QUEUE_SIZE) return false; // Too big transfer
+  osalSysLock();
+  while (i2c_wr + wn + 2 > I2C_QUEUE_SIZE) { // No space in queue, wait
+    osalSysUnlock();
+    i2c_wait();
+    osalSysLock();
+  }
+  i2c_queue[i2c_wr++] = addr;
+  i2c_queue[i2c_wr++] = wn;
+  do {
+    i2c_queue[i2c_wr++] = *w++;
+  } while (--wn);
+  if (!i2c_tx_busy)
+    i2c_queue_start();
+  osalSysUnlock();
+  return true;
+}
+#else
 // I2C TX only (compact version)
 bool i2c_transfer(uint8_t addr, const uint8_t *w, size_t wn)
 {
+  I2C_STAT_ADD(wn);
+  I2C_STAT_BEGIN;
   //if (wn == 0) return false;
   while(VNA_I2C->ISR & I2C_ISR_BUSY); // wait last transaction
   VNA_I2C->CR1|= I2C_CR1_PE;
   VNA_I2C->CR2 = (addr << I2C_CR2_SADD_7BIT_SHIFT) | (wn << I2C_CR2_NBYTES_SHIFT) | I2C_CR2_AUTOEND | I2C_CR2_START;
   do {
     while ((VNA_I2C->ISR & (I2C_ISR_TXE|I2C_ISR_NACKF)) == 0);
-    if (VNA_I2C->ISR & I2C_ISR_NACKF) {VNA_I2C->CR1 = 0; return false;}  // NO ASK error
+    if (VNA_I2C->ISR & I2C_ISR_NACKF) {VNA_I2C->CR1 = 0; I2C_STAT_END; return false;}  // NO ASK error
     VNA_I2C->TXDR = *w++;
   } while (--wn);
+  I2C_STAT_END;
   return true;
 }
+#endif
+
+void i2c_set_timings(uint32_t timings) {
+  i2c_wait();
+  VNA_I2C->CR1&=~I2C_CR1_PE;
+  VNA_I2C->TIMINGR = timings;
+  VNA_I2C->CR1|= I2C_CR1_PE;
+}
+
+void i2c_start(void) {
+  rccEnableI2C1(FALSE);
+  i2c_set_timings(STM32_I2C_INIT_T);
+#ifdef __USE_I2C_DMA__
+  dmaChannelSetPeripheral(I2C_DMA_TX, &VNA_I2C->TXDR);
+  nvicEnableVector(I2C_EV_IRQ_NUMBER, STM32_I2C_I2C1_IRQ_PRIORITY);
+#endif
+}
 
 // I2C TX and RX variant
 bool i2c_receive(uint8_t addr, const uint8_t *w, size_t wn, uint8_t *r, size_t rn)
 {
+  i2c_wait();                         // wait queued transfers
   while(VNA_I2C->ISR & I2C_ISR_BUSY); // wait last transaction
   VNA_I2C->CR1|= I2C_CR1_PE;
   if (wn) {
@@ -27,6 +27,9 @@ uint16_t lastsaveid = 0;
 #if SAVEAREA_MAX >= 8
 #error "Increase checksum_ok type for save more cache slots"
 #endif
+// Saved structures must fit flash areas (see hardware.h)
+_Static_assert(sizeof(config_t)     <= SAVE_CONFIG_SIZE,      "config_t bigger then SAVE_CONFIG_SIZE");
+_Static_assert(sizeof(properties_t) <= SAVE_PROP_CONFIG_SIZE, "properties_t bigger then SAVE_PROP_CONFIG_SIZE");
 
 // properties CRC check cache (max 8 slots)
 static uint8_t checksum_ok = 0;
@@ -244,6 +244,67 @@ fetch_amplitude_ref(float *gamma)
   gamma[1] =  acc_ref_c * 1e-9;
 }
 
+// Per buffer gamma statistic (running mean and variance by Welford algorithm)
+static acc_t prev_samp_s;
+static acc_t prev_samp_c;
+static acc_t prev_ref_s;
+static acc_t prev_ref_c;
+static uint16_t stat_n;
+static float stat_mean[2];
+static float stat_m2;
+
+// Call after every dsp_process, get gamma of last processed buffer and update statistic
+void
+dsp_stat_update(void)
+{
+  measure_t rs = acc_ref_s  - prev_ref_s;
+  measure_t rc = acc_ref_c  - prev_ref_c;
+  measure_t ss = acc_samp_s - prev_samp_s;
+  measure_t sc = acc_samp_c - prev_samp_c;
+  prev_ref_s  = acc_ref_s;
+  prev_ref_c  = acc_ref_c;
+  prev_samp_s = acc_samp_s;
+  prev_samp_c = acc_samp_c;
+  measure_t rr = rs * rs + rc * rc;
+  if (rr == 0.0f) return;
+  float g0 = (sc * rc + ss * rs) / rr;
+  float g1 = (ss * rc - sc * rs) / rr;
+  float d0 = g0 - stat_mean[0];
+  float d1 = g1 - stat_mean[1];
+  stat_n++;
+  stat_mean[0]+= d0 / stat_n;
+  stat_mean[1]+= d1 / stat_n;
+  stat_m2+= d0 * (g0 - stat_mean[0]) + d1 * (g1 - stat_mean[1]);
+}
+
+// Return true if mean gamma error^2 (variance / n) less then limit * |gamma|^2
+bool
+dsp_stat_converged(float limit)
+{
+  uint16_t n = stat_n;
+  if (n < 2) return false;
+  float level = stat_mean[0] * stat_mean[0] + stat_mean[1] * stat_mean[1];
+  return stat_m2 < limit * level * (n * (n - 1));
+}
+
+// Return standard error of mean gamma (sqrt(variance / n)), 0 if less 2 buffers processed
+float
+dsp_stat_error(void)
+{
+  uint16_t n = stat_n;
+  if (n < 2) return 0.0f;
+  return vna_sqrtf(stat_m2 / (n * (n - 1)));
+}
+
+// Return reference channel signal power (used for check signal stability)
+float
+get_ref_level(void)
+{
+  float rs = acc_ref_s;
+  float rc = acc_ref_c;
+  return rs * rs + rc * rc;
+}
+
 void
 reset_dsp_accumerator(void)
 {
@@ -251,4 +312,11 @@ reset_dsp_accumerator(void)
   acc_ref_c = 0;
   acc_samp_s = 0;
   acc_samp_c = 0;
+  prev_ref_s = 0;
+  prev_ref_c = 0;
+  prev_samp_s = 0;
+  prev_samp_c = 0;
+  stat_n = 0;
+  stat_mean[0] = stat_mean[1] = 0.0f;
+  stat_m2 = 0.0f;
 }
@@ -85,6 +85,24 @@ void i2c_start(void);
 void i2c_set_timings(uint32_t timings);
 bool i2c_transfer(uint8_t addr, const uint8_t *w, size_t wn);
 bool i2c_receive(uint8_t addr, const uint8_t *w, size_t wn, uint8_t *r, size_t rn);
+#ifdef __USE_I2C_DMA__
+// I2C transfers queued and send by DMA, need wait end if timings important
+void i2c_wait(void);
+bool i2c_busy(void);
+#else
+#define i2c_wait()
+#define i2c_busy()     false
+#endif
+#ifdef __USE_I2C_STAT__
+// I2C bus statistic
+typedef struct {
+  uint32_t wait;   // CPU wait I2C time (in I2C_STAT_GET_TIME units)
+  uint32_t count;  // TX transfers count
+  uint32_t bytes;  // TX bytes count
+} i2c_stat_t;
+extern i2c_stat_t i2c_stat;
+uint32_t i2c_stat_time_us(uint32_t t);
+#endif
 
 /*
  * rtc.c
@@ -282,6 +300,10 @@ extern void i2s_lld_serve_rx_interrupt(uint32_t flags);
 //#define DMA1_CH6_HANDLER_FUNC
 //#define DMA1_CH7_HANDLER_FUNC
 
+// Interrupt handler for I2C DMA queue end (all transfers complete)
+extern void i2c_lld_serve_tx_end(void);
+#define I2C_TX_END_HANDLER_FUNC                i2c_lld_serve_tx_end
+
 #define dmaChannelSetMemory(ch, addr)          {(ch)->CMAR = (uint32_t)(addr);}
 #define dmaChannelSetPeripheral(ch, addr)      {(ch)->CPAR = (uint32_t)(addr);}
 #define dmaChannelSetTransactionSize(ch, size) {(ch)->CNDTR= (uint32_t)(size);}
@@ -94,8 +94,12 @@ static volatile vna_shellcmd_t  shell_function = 0;
 //#define ENABLE_I2C_TIMINGS
 // Enable band setting command, used for debug
 //#define ENABLE_BAND_COMMAND
+// Enable generator and channel switch delays autotune command
+#define ENABLE_AUTOTUNE_COMMAND
 // Enable scan_bin command (need use ex scan in future)
 #define ENABLE_SCANBIN_COMMAND
+// Enable scan streaming output (send measured points while sweep in progress)
+#define ENABLE_SCAN_STREAM
 // Enable debug for console command
 //#define DEBUG_CONSOLE_SHOW
 // Enable usart command
@@ -110,6 +114,13 @@ static volatile vna_shellcmd_t  shell_function = 0;
 static void apply_CH0_error_term(float data[4], float c_data[CAL_TYPE_COUNT][2]);
 static void apply_CH1_error_term(float data[4], float c_data[CAL_TYPE_COUNT][2]);
 static void cal_interpolate(int idx, freq_t f, float data[CAL_TYPE_COUNT][2]);
+static void cal_sweep_data(uint16_t mask, int idx, freq_t f, float data[CAL_TYPE_COUNT][2]);
+#ifdef __USE_CAL_INTERP_CACHE__
+static void cal_interpolate_reset(void);
+static void cal_interpolate_update(void);
+#else
+#define cal_interpolate_reset()
+#endif
 
 static uint16_t get_sweep_mask(void);
 static void update_frequencies(void);
@@ -117,18 +128,25 @@ static int  set_frequency(freq_t freq);
 static void set_frequencies(freq_t start, freq_t stop, uint16_t points);
 static bool sweep(bool break_on_operation, uint16_t ch_mask);
 static void transform_domain(uint16_t ch_mask);
+#ifdef __USE_TD_GATE__
+static void gate_domain(uint16_t ch_mask);
+#endif
 
 uint8_t sweep_mode = SWEEP_ENABLE;
 // current sweep point (used for continue sweep if user break)
 static uint16_t p_sweep = 0;
 // Sweep measured data
 float measured[2][SWEEP_POINTS_MAX][2];
+#ifdef __USE_CCM_BUFFER__
+// Shared buffer in CCM RAM: time domain work buffer, sweep measured data noise or sweep caches
+float ccm_buffer[CCM_BUFFER_SIZE / sizeof(float)] __attribute__((section(".ram4_clear")));
+#endif
 
 #undef VERSION
 #define VERSION "1.2.52"
 
 // Version text, displayed in Config->Version menu, also send by info command
-const char *info_about[]={
+const char * const info_about[]={
   "Board: " BOARD_NAME,
   "2019-2024 Copyright @DiSlord (based on @edy555 source)",
   "Licensed under GPL.",
@@ -167,17 +185,8 @@ void my_debug_log(int offs, char *log){
 #endif
 
 #ifdef __USE_SMOOTH__
-static float arifmetic_mean(float v0, float v1, float v2){
-  return (v0+2*v1+v2)/4;
-}
-
-static float geometry_mean(float v0, float v1, float v2){
-  float v = vna_cbrtf(vna_fabsf(v0*v1*v2));
-  if (v0+v1+v2 < 0) v = -v;
-  return v;
-}
-
 uint8_t smooth_factor = 0;
+bool    smooth_median = false;
 void set_smooth_factor(uint8_t factor){
   if (factor > 8) factor = 8;
   smooth_factor = factor;
@@ -188,40 +197,180 @@ uint8_t get_smooth_factor(void) {
   return smooth_factor;
 }
 
+void set_smooth_median(bool median){
+  smooth_median = median;
+  request_to_redraw(REDRAW_CAL_STATUS);
+}
+
+bool get_smooth_median(void) {
+  return smooth_median;
+}
+
+// Max box filter half width (ring buffer size)
+#define SMOOTH_MAX_HALF    16
+// Median filter half width (5 points)
+#define SMOOTH_MEDIAN_HALF  2
+
+// One pass of symmetric box filter with half width h on data (step 2 for complex values),
+// on edges window shrink (first and last points not changed), old values stored in ring buffer
+static void smooth_box(float *data, int n, int h){
+  float ring[SMOOTH_MAX_HALF + 1];
+  float sum = 0.0f;
+  int l = 0, r = -1, j;
+  for (j = 0; j < n; j++){
+    int hj = h;
+    if (hj > j)         hj = j;
+    if (hj > n - 1 - j) hj = n - 1 - j;
+    while (r < j + hj) sum+= data[2 * ++r];
+    while (l < j - hj) sum-= ring[l++ % (SMOOTH_MAX_HALF + 1)];
+    ring[j % (SMOOTH_MAX_HALF + 1)] = data[2*j];
+    data[2*j] = sum / (2 * hj + 1);
+  }
+}
+
+// 3 point binomial filter [1 2 1]/4 pass, first and last points not changed
+static void smooth_121(float *data, int n){
+  float prev = data[0];
+  for (int j = 1; j < n - 1; j++){
+    float v = data[2*j];
+    data[2*j] = 0.25f * (prev + 2.0f * v + data[2*j+2]);
+    prev = v;
+  }
+}
+
+static float median5(float *v){
+  // Partial insertion sort, need only middle value
+  for (int i = 1; i < 5; i++)
+    for (int k = i; k > 0 && v[k] < v[k-1]; k--) {float t = v[k]; v[k] = v[k-1]; v[k-1] = t;}
+  return v[2];
+}
+
+// 5 points median filter (remove single spikes), 2 first and last points not changed
+static void smooth_median5(float *data, int n){
+  float prev[SMOOTH_MEDIAN_HALF];
+  if (n < 2*SMOOTH_MEDIAN_HALF + 1) return;
+  prev[0] = data[0];
+  prev[1] = data[2];
+  for (int j = SMOOTH_MEDIAN_HALF; j < n - SMOOTH_MEDIAN_HALF; j++){
+    float v[5] = {prev[0], prev[1], data[2*j], data[2*j+2], data[2*j+4]};
+    prev[0] = prev[1];
+    prev[1] = data[2*j];
+    data[2*j] = median5(v);
+  }
+}
+
 // Allow smooth complex data point array (this remove noise, smooth power depend form count)
 // see https://terpconnect.umd.edu/~toh/spectrum/Smoothing.html
+// Old version made 2^(factor-1) passes of 3 point filter (arithmetic [1 2 1]/4 or geometric cbrt(v0*v1*v2)),
+// now factor 1 and 2 made as before (geometric 3 point pass is box filter h = 1), bigger factors by not more
+// 3 passes of box filter with same variance (Gaussian like result), so time not depend from factor:
+// 3 point arithmetic pass variance 1/2, geometric 2/3, box filter (2h+1 points) variance h(h+1)/3
+// Geometric mean calculated as exp(mean(log|v|)), sign from source point
 static void measurementDataSmooth(uint16_t ch_mask){
-  int j;
-//  ch_mask = 2;
-//  memcpy(measured[0], measured[1], sizeof(measured[0]));
-  float (*smooth_func)(float v0, float v1, float v2) = VNA_MODE(VNA_MODE_SMOOTH) ? arifmetic_mean : geometry_mean;
+  uint32_t sign[(SWEEP_POINTS_MAX + 31) / 32];
+  int h = 0, passes = 0;
+  bool geometry = !VNA_MODE(VNA_MODE_SMOOTH);
+  if (smooth_factor) {
+    int k = 1<<(smooth_factor-1);
+    int target = geometry ? 4 * k : 3 * k;      // variance * 6
+    passes = k < 3 ? k : 3;
+    for (h = 1; h < SMOOTH_MAX_HALF && 2*passes*(h+1)*(h+2) - target < target - 2*passes*h*(h+1); h++)
+      ;
+  }
   for (int ch = 0; ch < 2; ch++,ch_mask>>=1) {
     if ((ch_mask&1)==0) continue;
-    int count = 1<<(smooth_factor-1), n;
-    float *data = measured[ch][0];
-    for (n = 0; n < count; n++){
-      float prev_re = data[2*0  ];
-      float prev_im = data[2*0+1];
-// first point smooth (use first and second points), disabled it made phase shift
-//      data[0] = smooth_func(prev_re, prev_re, data[2  ]);
-//      data[1] = smooth_func(prev_im, prev_im, data[2+1]);
-// simple data smooth on 3 points
-      for (j = 1; j < sweep_points - 1; j++){
-        float old_re = data[2*j  ]; // save current data point for next point smooth
-        float old_im = data[2*j+1];
-        data[2*j  ] = smooth_func(prev_re, data[2*j  ], data[2*j+2]);
-        data[2*j+1] = smooth_func(prev_im, data[2*j+1], data[2*j+3]);
-        prev_re = old_re;
-        prev_im = old_im;
+    for (int c = 0; c < 2; c++) {
+      float *data = &measured[ch][0][c];
+      if (smooth_median) smooth_median5(data, sweep_points);
+      if (passes == 0) continue;
+      if (geometry) {                           // Filter log|v| in place, store sign in bit array
+        for (int j = 0; j < sweep_points; j++) {
+          float v = data[2*j];
+          if (v < 0) sign[j>>5]|= 1U<<(j&31); else sign[j>>5]&= ~(1U<<(j&31));
+          v = vna_fabsf(v);
+          data[2*j] = vna_logf(v > 1e-30f ? v : 1e-30f);
+        }
+      }
+      for (int p = 0; p < passes; p++) {
+        if (!geometry && passes < 3) smooth_121(data, sweep_points);
+        else                         smooth_box(data, sweep_points, h);
+      }
+      if (geometry) {
+        for (int j = 0; j < sweep_points; j++) {
+          float v = vna_expf(data[2*j]);
+          data[2*j] = (sign[j>>5] & (1U<<(j&31))) ? -v : v;
+        }
       }
-// last point smooth, disabled it made phase shift
-//      data[2*j  ] = smooth_func(data[2*j  ], data[2*j  ], prev_re);
-//      data[2*j+1] = smooth_func(data[2*j+1], data[2*j+1], prev_im);
     }
   }
 }
 #endif
 
+#ifdef __USE_AVERAGE__
+// Sweep to sweep vector averaging, made in dedicated buffer (measured data modified by smooth,
+// time domain or gate after sweep, so can`t be used as average for next sweep):
+//  avg+= (data - avg) / n, n = averaged sweeps count + 1
+// Exponential mode limit n by average count, block mode restart averaging after count sweeps
+// Average calculated in float and output to measured, stored in CCM buffer as half float with
+// stochastic rounding (small exponential mode updates not lost, rounding not biased)
+#define average_data  ccm_average
+static uint8_t average_count = 0;
+static uint8_t average_mode  = AVERAGE_EXP;
+static uint8_t average_n     = 0;
+
+// Restart averaging (need call on any measure settings change)
+static void average_reset(void) {
+  average_n = 0;
+  p_sweep = 0;
+}
+
+void set_average(uint8_t count, uint8_t mode) {
+  average_count = count;
+  average_mode  = mode;
+  average_reset();
+  request_to_redraw(REDRAW_CAL_STATUS);
+}
+
+uint8_t get_average_count(void) {
+  return average_count;
+}
+
+uint8_t get_average_mode(void) {
+  return average_mode;
+}
+
+// Return data factor for current sweep
+static float average_factor(void) {
+  uint16_t n = average_n + 1;
+  if (n > average_count) n = average_count;
+  return 1.0f / n;
+}
+
+// Random value for stochastic rounding (xorshift32)
+static uint32_t average_rnd(void) {
+  static uint32_t x = 1;
+  x^= x << 13; x^= x >> 17; x^= x << 5;
+  return x;
+}
+
+// Add point data to average, and return averaged value in data
+static void average_point(uint16_t *avg, float *data, float k) {
+  for (int i = 0; i < 2; i++) {
+    if (k < 1.0f) data[i]+= (vna_h2f(avg[i]) - data[i]) * (1.0f - k);
+    avg[i] = vna_f2h(data[i], average_rnd());
+  }
+}
+
+// Call on sweep complete, return true if averaged data ready
+static bool average_done(void) {
+  if (++average_n < average_count) return average_mode == AVERAGE_EXP;
+  average_n = average_mode == AVERAGE_BLOCK ? 0 : average_count;
+  return true;
+}
+#else
+#define average_reset()
+#endif
+
 static THD_WORKING_AREA(waThread1, 1024);
 static THD_FUNCTION(Thread1, arg)
 {
@@ -260,12 +409,15 @@ static THD_FUNCTION(Thread1, arg)
     if (completed) {
 #ifdef __USE_SMOOTH__
 //    START_PROFILE;
-      if (smooth_factor)
+      if (smooth_factor || smooth_median)
         measurementDataSmooth(mask);
 //    STOP_PROFILE;
 #endif
 //      START_PROFILE
       if ((props_mode & DOMAIN_MODE) == DOMAIN_TIME) transform_domain(mask);
+#ifdef __USE_TD_GATE__
+      else if (props_mode & TD_GATE) gate_domain(mask);
+#endif
 //      STOP_PROFILE;
       // Prepare draw graphics, cache all lines, mark screen cells for redraw
       request_to_redraw(REDRAW_PLOT);
@@ -374,14 +526,193 @@ static float kaiser_window_ext(uint32_t k, uint32_t n, uint16_t beta) {
   return bessel_I0_ext((float)k / n);
 }
 
-static void
-transform_domain(uint16_t ch_mask)
-{
-  // use spi_buffer as temporary buffer and calculate ifft for time domain
-  // Need 2 * sizeof(float) * FFT_SIZE bytes for work
+#ifdef __USE_CCM_BUFFER__
+// Get CCM buffer for work (time domain or noise), sweep caches placed in it become invalid
+static float *ccm_buffer_work(void) {
+  si5351_plan_cache_reset();
+  cal_interpolate_reset();
+  return ccm_buffer;
+}
+// Time domain need CCM shared area for chirp-Z and FFT size bigger then FFT_SIZE
+#ifdef __USE_FFT_SIZE_SELECT__
+#define TD_USE_CCM()  (TD_ZOOM_ENABLED() || td_fft_size() > FFT_SIZE)
+#else
+#define TD_USE_CCM()  false
+#endif
+// Sweep caches can use CCM buffer only if it not need for time domain or noise
+#define SWEEP_CACHE_ENABLED(mask)  (!((mask) & SWEEP_MEASURE_NOISE) && ((props_mode & DOMAIN_MODE) == DOMAIN_FREQ || !TD_USE_CCM()))
+#else
+#define SWEEP_CACHE_ENABLED(mask)  true
+#endif
+
+// Time domain temporary buffer for FFT up to FFT_SIZE (and gate), need 2 * sizeof(float) * FFT_SIZE bytes for work
 #if 2*4*FFT_SIZE > (SPI_BUFFER_SIZE * LCD_PIXEL_SIZE)
 #error "Need increase spi_buffer or use less FFT_SIZE value"
 #endif
+#define TD_BUFFER  ((float*)spi_buffer)
+
+// Kaiser window beta for selected time domain window
+static uint16_t td_window_beta(void) {
+  switch (domain_window) {
+//  case TD_WINDOW_MINIMUM: return 0; // this is rectangular
+    case TD_WINDOW_NORMAL:  return 6;
+    case TD_WINDOW_MAXIMUM: return 13;
+    case TD_WINDOW_USER:    return td_beta;
+  }
+  return 0;
+}
+
+// Time domain window function value for k = 0 ... n-1 (normalized to max = 1.0)
+static float td_window_value(uint32_t k, uint32_t n) {
+  float s, c;
+  vna_sincosf((float)k / (n - 1), &s, &c);
+  switch (props_mode & TD_WINDOW_TYPE) {
+    case TD_WINDOW_HANN:
+      return 0.5f - 0.5f * c;
+    case TD_WINDOW_BLACKMAN: {
+      // 4 term Blackman-Harris, use cos(2x) = 2c^2 - 1, cos(3x) = 4c^3 - 3c
+      float c2 = 2.0f * c * c - 1.0f;
+      float c3 = c * (2.0f * c2 - 1.0f);
+      return 0.35875f - 0.48829f * c + 0.14128f * c2 - 0.01168f * c3;
+    }
+  }
+  uint16_t beta = td_window_beta();
+  return kaiser_window_ext(k, n, beta) / bessel_I0_ext(beta*beta/4.0f);
+}
+
+// Window value in 0 ... 0xFFFF = 0.0 ... 1.0 range
+static uint16_t td_window_u16(uint32_t k, uint32_t n) {
+  return td_window_value(k, n) * 65535.0f + 0.5f;
+}
+
+// Time domain window cache and it key (used points, function, window, beta)
+#ifdef __USE_CCM_BUFFER__
+#define td_window  ccm_td_window
+#else
+static uint16_t td_window[SWEEP_POINTS_MAX];
+#endif
+static uint32_t td_window_key = 0;
+
+#ifdef __USE_CCM_BUFFER__
+// Sweep caches use CCM buffer up to average accumulator (if averaging enabled) or time domain window cache (in time domain mode)
+uint16_t ccm_cache_size(void) {
+#ifdef __USE_AVERAGE__
+  if (average_count > 1) return CCM_AVERAGE_OFFSET;
+#endif
+  return (props_mode & DOMAIN_MODE) == DOMAIN_TIME ? CCM_TD_WINDOW_OFFSET : CCM_BUFFER_SIZE;
+}
+
+// On sweep caches size change plan cache need rebuild, and window cache can be overwritten by it
+static void ccm_cache_update(void) {
+  static uint16_t size = 0;
+  if (size == ccm_cache_size()) return;
+  size = ccm_cache_size();
+  si5351_plan_cache_reset();
+  td_window_key = 0;
+}
+#else
+#define ccm_cache_update()
+#endif
+
+#ifdef __USE_TD_ZOOM__
+#ifdef __USE_FFT_SIZE_SELECT__
+// Chirp-Z by Bluestein algorithm, use 2 work arrays of FFT_SIZE: CCM shared area and TD_BUFFER (F072 use direct calculation)
+#define TD_ZOOM_BLUESTEIN
+#endif
+// Chirp-Z (zoom) time domain transform, calculate time response only in user set time window
+// Evaluate sum(X[k] * z^k) on unit circle z = exp(j*2*pi*df*t), t = start ... stop
+static void
+transform_domain_zoom(float *tmp, float *data)
+{
+  int i, k, n = sweep_points - 1;
+  const uint16_t fft_size = td_fft_size();
+  // Time in df periods (FFT bin u = t * df * fft_size)
+  float df = (float)get_sweep_frequency(ST_SPAN) / n;
+  float t0 = td_zoom_start * df;
+  float dt = (td_zoom_stop - td_zoom_start) * df / n;
+  float x0 = tmp[0], c = 0.0f;
+  if (domain_func == TD_FUNC_LOWPASS_STEP) {
+    // Step is impulse summ on FFT grid: sum(z^(k*m), m = 0 ... u) = (1 - w^k * z^k) / (1 - w^k), w = exp(j*2*pi/fft_size), z = exp(j*2*pi*u/fft_size)
+    // 1 / (1 - exp(j*a)) = 0.5 + 0.5j * cot(a/2)
+    for (k = 1; k <= n; k++) {
+      float s, co;
+      vna_sincosf(k * (0.5f / fft_size), &s, &co);
+      float ct = 0.5f * co / s, re = tmp[2 * k + 0], im = tmp[2 * k + 1];
+      tmp[2 * k + 0] = 0.5f * re - ct * im;
+      tmp[2 * k + 1] = 0.5f * im + ct * re;
+      c+= tmp[2 * k + 0];
+    }
+    tmp[0] = tmp[1] = 0.0f;
+    t0+= 1.0f / fft_size;
+  }
+#ifdef TD_ZOOM_BLUESTEIN
+  // k*i = (k^2 + i^2 - (i-k)^2) / 2, so sum(X[k] * z^(k*i)) = w(i) * sum(a[k] * conj(w(i-k))),
+  // a[k] = X[k] * exp(j*2*pi*t0*k) * w(k), w(m) = exp(j*pi*dt*m^2)
+  // Convolution made by FFT of size L, if 2*n+1 > L made in blocks (every block give L - n outputs)
+  const float h = dt / 2;
+  uint16_t L = 2;
+  while (L < 2 * n + 1 && L < FFT_SIZE) L<<= 1;
+  float *A = tmp, *B = TD_BUFFER;
+  for (k = 0; k <= n; k++) {
+    float s, co, re = A[2 * k + 0], im = A[2 * k + 1];
+    vna_sincosf(h * (k * k) + t0 * k, &s, &co);
+    A[2 * k + 0] = re * co - im * s;
+    A[2 * k + 1] = re * s + im * co;
+  }
+  for (; k < L; k++)
+    A[2 * k + 0] = A[2 * k + 1] = 0.0f;
+  fft_ex((float(*)[2])A, L, 0);
+  const float scale = 1.0f / L;
+  for (int i0 = 0; i0 <= n; i0+= L - n) {
+    // B[k] = conj(w(i0 - n + k)), circular convolution output n + i - i0 not wrapped for i - i0 < L - n
+    for (k = 0; k < L; k++) {
+      int m = i0 - n + k;
+      vna_sincosf(-h * (m * m), &B[2 * k + 1], &B[2 * k + 0]);
+    }
+    fft_ex((float(*)[2])B, L, 0);
+    for (k = 0; k < L; k++) {
+      float re = B[2 * k + 0], im = B[2 * k + 1];
+      B[2 * k + 0] = A[2 * k + 0] * re - A[2 * k + 1] * im;
+      B[2 * k + 1] = A[2 * k + 0] * im + A[2 * k + 1] * re;
+    }
+    fft_ex((float(*)[2])B, L, 1);
+    for (i = i0; i <= n && i < i0 + L - n; i++) {
+      float s, co, re = B[2 * (n + i - i0) + 0] * scale, im = B[2 * (n + i - i0) + 1] * scale;
+      vna_sincosf(h * (i * i), &s, &co);
+      data[2 * i + 0] = re * co - im * s;
+      data[2 * i + 1] = re * s + im * co;
+    }
+  }
+#else
+  // Direct calculation by Horner scheme (need n^2 complex mul)
+  for (i = 0; i <= n; i++) {
+    float s, co;
+    vna_sincosf(t0 + i * dt, &s, &co);
+    float re = tmp[2 * n + 0], im = tmp[2 * n + 1];
+    for (k = n - 1; k >= 0; k--) {
+      float r = vna_fmaf(re, co, tmp[2 * k + 0] - im * s);
+      im      = vna_fmaf(re, s,  tmp[2 * k + 1] + im * co);
+      re      = r;
+    }
+    data[2 * i + 0] = re;
+    data[2 * i + 1] = im;
+  }
+#endif
+  for (i = 0; i <= n; i++) {
+    float t = t0 + i * dt;
+    switch (domain_func) {
+      case TD_FUNC_LOWPASS_IMPULSE: data[2 * i + 0] = 2.0f * data[2 * i + 0] - x0;                   data[2 * i + 1] = 0.0f; break; // X[0] + 2 * Re(sum(X[k] * z^k), k = 1 ... n)
+      case TD_FUNC_LOWPASS_STEP:    data[2 * i + 0] = x0 * t * fft_size + 2.0f * (c - data[2 * i + 0]); data[2 * i + 1] = 0.0f; break;
+    }
+  }
+}
+#endif
+
+static void
+transform_domain(uint16_t ch_mask)
+{
+  // use TD_BUFFER as temporary buffer and calculate ifft for time domain
+  const uint16_t fft_size = td_fft_size();
   int i;
   uint16_t offset = 0;
   uint8_t is_lowpass = FALSE;
@@ -391,96 +722,220 @@ transform_domain(uint16_t ch_mask)
     case TD_FUNC_LOWPASS_IMPULSE:
     case TD_FUNC_LOWPASS_STEP:
       is_lowpass = TRUE;
-      offset = sweep_points;
       break;
   }
-  uint16_t window_size = sweep_points + offset;
-  uint16_t beta = 0;
-  switch (domain_window) {
-//    case TD_WINDOW_MINIMUM:
-//    beta = 0;  // this is rectangular
-//      break;
-    case TD_WINDOW_NORMAL:
-      beta = 6;
-      break;
-    case TD_WINDOW_MAXIMUM:
-      beta = 13;
-      break;
+  // Points used in transform: lowpass real iFFT use fft_size/2 + 1 points, bandpass fft_size (Chirp-Z use all)
+  uint16_t window_points = sweep_points;
+  if (!TD_ZOOM_ENABLED()) {
+    uint16_t max_points = is_lowpass ? fft_size/2 + 1 : fft_size;
+    if (window_points > max_points) window_points = max_points;
   }
-  // Add amplitude correction for not full size FFT data and also add computed default scale
-  // recalculate the scale factor if any window details are changed. The scale factor is to compensate for windowing.
-  // Add constant multiplier for kaiser_window_ext use 1.0f / bessel0_ext(beta*beta/4.0f)
-  // Add constant multiplier 1.0f / FFT_SIZE
+  if (is_lowpass) offset = window_points;
+  uint16_t window_size = window_points + offset;
+  // Window function (0 ... 0xFFFF = 0.0 ... 1.0) cache and scale factor for compensate windowing
+  // Recalculate only if any window details (used points, function, window, beta) are changed
   static float window_scale = 0.0f;
-  static uint16_t td_cache = 0;
-  // Check mode cache data
-  uint16_t td_check = (props_mode & (TD_WINDOW|TD_FUNC))|(sweep_points<<5);
-  if (td_cache!=td_check){
-    td_cache = td_check;
+  ccm_cache_update();
+  uint32_t td_check = (props_mode & (TD_WINDOW|TD_WINDOW_TYPE|TD_FUNC|TD_FFT_SIZE))|((uint32_t)window_points<<16)|((uint32_t)td_beta<<25);
+  if (td_window_key!=td_check){
+    td_window_key = td_check;
+    float sum = 0.0f;
+    for (i = 0; i < window_points; i++)
+      sum+= td_window[i] = td_window_u16(i + offset, window_size);
+    // Add amplitude correction for not full size FFT data and also add computed default scale
     if (domain_func == TD_FUNC_LOWPASS_STEP)
-      window_scale = FFT_SIZE * bessel_I0_ext(beta*beta/4.0f);
-    else {
-      window_scale = 0.0f;
-      for (int i = 0; i < sweep_points; i++)
-        window_scale += kaiser_window_ext(i + offset, window_size, beta);
-      if (domain_func == TD_FUNC_LOWPASS_IMPULSE) window_scale*= 2.0f;
-//    window_scale/= FFT_SIZE                      // add correction from kaiser_window summ
-//    window_scale*= FFT_SIZE                      // add default from FFT_SIZE
-//    window_scale/= bessel_I0_ext(beta*beta/4.0f) // for get result as kaiser_window summ
-//    window_scale*= bessel_I0_ext(beta*beta/4.0f) // for set correction on calculated kaiser_window for value
+      sum = 65535.0f * fft_size;
+    else if (domain_func == TD_FUNC_LOWPASS_IMPULSE)
+      sum*= 2.0f;
+    window_scale = 1.0f / sum;
+  }
+  // Made Time Domain Calculations
+  float* tmp = TD_BUFFER;
+#ifdef __USE_FFT_SIZE_SELECT__
+  if (fft_size > FFT_SIZE && !TD_ZOOM_ENABLED()) {
+    // Windowed data in CCM buffer, iFFT made by FFT_SIZE parts in TD_BUFFER (need only sweep_points outputs)
+    // Lowpass real result x[n] = X[0] + 2 * Re(sum(X[k] * w^(k*n))), X[fft_size/2] = 0 (sweep_points < fft_size/2)
+    float (*in)[2] = (float (*)[2])ccm_buffer_work();
+    for (int ch = 0; ch < 2; ch++,ch_mask>>=1) {
+      if ((ch_mask&1)==0) continue;
+      float (*data)[2] = measured[ch];
+      for (i = 0; i < sweep_points; i++) {
+        float w = td_window[i] * window_scale;
+        if (is_lowpass && i) w*= 2.0f;
+        in[i][0] = data[i][0] * w;
+        in[i][1] = data[i][1] * w;
+      }
+      fft_inverse_pruned((const float (*)[2])in, sweep_points, data, sweep_points, fft_size, (float (*)[2])tmp);
+      if (!is_lowpass) continue;
+      for (i = 0; i < sweep_points; i++) {
+        if (domain_func == TD_FUNC_LOWPASS_STEP && i) data[i][0]+= data[i - 1][0];
+        data[i][1] = 0.0f;
+      }
     }
-    window_scale = 1.0f / window_scale;
-#ifdef USE_FFT_WINDOW_BUFFER
-    // Cache window function data to static buffer
-    static float kaiser_data[FFT_SIZE];
-    for (i = 0; i < sweep_points; i++)
-      kaiser_data[i] = kaiser_window_ext(i + offset, window_size, beta) * window_scale;
+    return;
+  }
 #endif
+#ifdef TD_ZOOM_BLUESTEIN
+  // Chirp-Z input and Bluestein first work array placed in CCM buffer
+  if (TD_ZOOM_ENABLED()) tmp = ccm_buffer_work();
+#endif
+  if (is_lowpass && !TD_ZOOM_ENABLED()) {
+    // The IFFT of the Hermitian conjugate spectrum is real, need only fft_size/2 + 1 points, other restored from conjugate
+    // Pack spectrum of all channels one after another (fft_size/2 points for every channel)
+    // and made real iFFT for all in one pass (shared window and twiddle factors)
+    const uint16_t M = fft_size/2;
+    float *src[2], *dst[2];
+    int c, count = 0;
+    for (int ch = 0; ch < 2; ch++) {
+      if ((ch_mask & (1<<ch)) == 0) continue;
+      src[count] = measured[ch][0];
+      dst[count] = &tmp[count * fft_size];
+      count++;
+    }
+    uint16_t data_points = sweep_points < M ? sweep_points : M;
+    for (i = 0; i < data_points; i++) {
+      float w = td_window[i] * window_scale;
+      for (c = 0; c < count; c++) {
+        dst[c][i * 2 + 0] = src[c][i * 2 + 0] * w;
+        dst[c][i * 2 + 1] = src[c][i * 2 + 1] * w;
+      }
+    }
+    // Fill zeroes last
+    for (; i < M; i++) {
+      for (c = 0; c < count; c++)
+        dst[c][i * 2 + 0] = dst[c][i * 2 + 1] = 0.0f;
+    }
+    // Real part of X[fft_size/2] packed in unused imaginary part of X[0]
+    for (c = 0; c < count; c++)
+      dst[c][1] = M < sweep_points ? src[c][M * 2] * td_window[M] * window_scale : 0.0f;
+    fft_inverse_real((float(*)[2])tmp, fft_size, count);
+    // Real result packed in dst[c][0 ... fft_size - 1]
+    for (c = 0; c < count; c++) {
+      if (domain_func == TD_FUNC_LOWPASS_STEP) {
+        for (i = 1; i < sweep_points; i++)
+          dst[c][i]+= dst[c][i - 1];
+      }
+      for (i = 0; i < sweep_points; i++) {
+        src[c][i * 2 + 0] = dst[c][i];
+        src[c][i * 2 + 1] = 0.0f;
+      }
+    }
+    return;
   }
-  // Made Time Domain Calculations
   for (int ch = 0; ch < 2; ch++,ch_mask>>=1) {
     if ((ch_mask&1)==0) continue;
-    // Prepare data in tmp buffer (use spi_buffer), apply window function and constant correction factor
-    float* tmp  = (float*)spi_buffer;
+    // Prepare data in tmp buffer, apply window function and constant correction factor
     float *data = measured[ch][0];
-    for (i = 0; i < sweep_points; i++) {
-#ifdef USE_FFT_WINDOW_BUFFER
-      float w = kaiser_data[i];
-#else
-      float w = kaiser_window_ext(i + offset, window_size, beta) * window_scale;
+    uint16_t fft_points = fft_size;
+#ifdef __USE_TD_ZOOM__
+    if (TD_ZOOM_ENABLED()) fft_points = sweep_points; // Chirp-Z use all points
 #endif
+    uint16_t data_points = sweep_points < fft_points ? sweep_points : fft_points;
+    for (i = 0; i < data_points; i++) {
+      float w = td_window[i] * window_scale;
       tmp[i * 2 + 0] = data[i * 2 + 0] * w;
       tmp[i * 2 + 1] = data[i * 2 + 1] * w;
     }
     // Fill zeroes last
-    for (; i < FFT_SIZE; i++) {
+    for (; i < fft_points; i++) {
       tmp[i * 2 + 0] = 0.0f;
       tmp[i * 2 + 1] = 0.0f;
     }
-    // For lowpass mode swap
-    if (is_lowpass) {
-      for (i = 1; i < sweep_points; i++) {
-        tmp[(FFT_SIZE - i) * 2 + 0] =  tmp[i * 2 + 0];
-        tmp[(FFT_SIZE - i) * 2 + 1] = -tmp[i * 2 + 1];
-      }
+#ifdef __USE_TD_ZOOM__
+    if (TD_ZOOM_ENABLED()) {
+      transform_domain_zoom(tmp, data);
+      continue;
     }
+#endif
     // Made iFFT in temp buffer
-    fft_inverse((float(*)[2])tmp);
-    if (is_lowpass) {
-      // The IFFT of the Hermitian conjugate spectrum contains 0 in the imaginary part, just for safe
-      for (i = 1; i < sweep_points*2; i+=2) tmp[i] = 0.0f;
+    fft_ex((float(*)[2])tmp, fft_size, 1);
+    // Copy data back
+    for (i = 0; i < 2 * sweep_points; i++) data[i] = tmp[i];
+  }
+}
 
-      if (domain_func == TD_FUNC_LOWPASS_STEP) {
-        for (i = 1; i < sweep_points; i++) {
-          tmp[i * 2 + 0]+= tmp[(i - 1) * 2 + 0];
-//        tmp[i * 2 + 1]+= tmp[(i - 1) * 2 + 1];  // already zero as is_lowpass
-        }
-      }
+#ifdef __USE_TD_GATE__
+// Gate: center, flat area half size and edge size in FFT bins, edge values table (0 ... 0xFFFF = 0.0 ... 1.0)
+// from flat area to edge end, gate value on FFT bin linear interpolated from table
+// Prepared on every gate call in stack (need less 100 I0 calculations, not use static RAM)
+#define TD_GATE_EDGE_SIZE  64
+typedef struct {
+  float center, flat, edge, edge_k;
+  uint16_t e[TD_GATE_EDGE_SIZE + 1];
+} td_gate_t;
+
+static void
+gate_prepare(td_gate_t *g)
+{
+  // Gate center and span in FFT bins (bin = t * df * FFT_SIZE)
+  float bins = (float)get_sweep_frequency(ST_SPAN) * FFT_SIZE / (sweep_points - 1);
+  float span = td_gate_span * bins;
+  // Flat gate area with Kaiser window edges (edge placed on gate span bounds)
+  uint16_t beta = 0;
+  float edge = 0.0f;
+  switch (props_mode & TD_WINDOW) {
+//  case TD_WINDOW_MINIMUM: // rectangular gate
+//    break;
+    case TD_WINDOW_NORMAL:  beta =  6; edge = span / 4; break;
+    case TD_WINDOW_MAXIMUM: beta = 13; edge = span / 2; break;
+    case TD_WINDOW_USER:    beta = td_beta; edge = span / 4; break;
+  }
+  g->center = td_gate_center * bins;
+  g->flat   = (span - edge) / 2;
+  g->edge   = edge;
+  g->edge_k = edge > 0.0f ? TD_GATE_EDGE_SIZE / edge : 0.0f;
+  // Kaiser window half from max to end: I0(beta^2/4 * (1 - x^2)) / I0(beta^2/4), x = 0 ... 1
+  float scale = 65535.0f / bessel_I0_ext(beta*beta/4.0f);
+  for (int i = 0; i <= TD_GATE_EDGE_SIZE; i++) {
+    float x = (float)i / TD_GATE_EDGE_SIZE;
+    g->e[i] = bessel_I0_ext(beta*beta/4.0f * (1.0f - x * x)) * scale;
+  }
+}
+
+// Gate value on FFT bin (0 ... 65535.0)
+static float
+gate_value(const td_gate_t *g, int i)
+{
+  // Distance from gate center (time domain data is circular, negative time at end)
+  float d = i - g->center;
+  if      (d >  FFT_SIZE/2) d-= FFT_SIZE;
+  else if (d < -FFT_SIZE/2) d+= FFT_SIZE;
+  float x = vna_fabsf(d) - g->flat;
+  if (x <= 0.0f)      return 65535.0f;
+  if (x >= g->edge)   return 0.0f;
+  x*= g->edge_k;
+  int j = x;
+  if (j >= TD_GATE_EDGE_SIZE) return g->e[TD_GATE_EDGE_SIZE];
+  return g->e[j] + (g->e[j + 1] - g->e[j]) * (x - j);
+}
+
+// Time domain gating: iFFT, apply gate and FFT back to frequency domain
+static void
+gate_domain(uint16_t ch_mask)
+{
+  int i;
+  td_gate_t gate;
+  gate_prepare(&gate);
+  // iFFT + FFT result multiplied by fft_size (gate always use FFT_SIZE in TD_BUFFER)
+  const uint16_t fft_size = FFT_SIZE;
+  const float scale = 1.0f / (65535.0f * fft_size);
+  for (int ch = 0; ch < 2; ch++,ch_mask>>=1) {
+    if ((ch_mask&1)==0) continue;
+    float* tmp  = TD_BUFFER;
+    float *data = measured[ch][0];
+    for (i = 0; i < 2 * sweep_points; i++) tmp[i] = data[i];
+    for (     ; i < 2 * fft_size;     i++) tmp[i] = 0.0f;
+    fft_ex((float(*)[2])tmp, fft_size, 1);
+    for (i = 0; i < fft_size; i++) {
+      float g = gate_value(&gate, i) * scale;
+      tmp[i * 2 + 0]*= g;
+      tmp[i * 2 + 1]*= g;
     }
-    // Copy data back
+    fft_ex((float(*)[2])tmp, fft_size, 0);
     for (i = 0; i < 2 * sweep_points; i++) data[i] = tmp[i];
   }
 }
+#endif
 
 // Shell commands output
 int shell_printf(const char *fmt, ...)
@@ -549,15 +1004,34 @@ VNA_SHELL_FUNCTION(cmd_reset)
 #ifdef __USE_SMOOTH__
 VNA_SHELL_FUNCTION(cmd_smooth)
 {
+  if (argc == 2 && get_str_index(argv[0], "median") == 0) {
+    set_smooth_median(my_atoui(argv[1]) != 0);
+    return;
+  }
   if (argc != 1) {
     shell_printf("usage: %s" VNA_SHELL_NEWLINE_STR \
-                 "current: %u" VNA_SHELL_NEWLINE_STR, "smooth {0-8}", smooth_factor);
+                 "current: %u, median %u" VNA_SHELL_NEWLINE_STR, "smooth {0-8}|median {0|1}", smooth_factor, smooth_median);
     return;
   }
   set_smooth_factor(my_atoui(argv[0]));
 }
 #endif
 
+#ifdef __USE_AVERAGE__
+VNA_SHELL_FUNCTION(cmd_average)
+{
+  static const char cmd_avg_list[] = "exp|block";
+  int mode = average_mode;
+  if (argc == 0 || argc > 2 || (argc == 2 && (mode = get_str_index(argv[1], cmd_avg_list)) < 0)) {
+    shell_printf("usage: %s" VNA_SHELL_NEWLINE_STR \
+                 "current: %u %s" VNA_SHELL_NEWLINE_STR, "average {0-255} [exp|block]", average_count, average_mode == AVERAGE_EXP ? "exp" : "block");
+    return;
+  }
+  uint16_t count = my_atoui(argv[0]);
+  set_average(count > 255 ? 255 : count, mode);
+}
+#endif
+
 #ifdef ENABLE_CONFIG_COMMAND
 VNA_SHELL_FUNCTION(cmd_config) {
   static const char cmd_mode_list[] =
@@ -650,6 +1124,7 @@ void set_power(uint8_t value){
   if (value > SI5351_CLK_DRIVE_STRENGTH_8MA) value = SI5351_CLK_DRIVE_STRENGTH_AUTO;
   if (current_props._power == value) return;
   current_props._power = value;
+  average_reset();
   // Update power if pause, need for generation in CW mode
   if (!(sweep_mode&SWEEP_ENABLE)) si5351_set_power(value);
 }
@@ -937,13 +1412,22 @@ static void load_default_properties(void) {
   current_props._var_delay       = 0.0f;
   current_props._s21_offset      = 0.0f;
   current_props._portz           = 50.0f;
+  current_props._portz_x         = 0.0f;
   current_props._cal_load_r      = 50.0f;
+  current_props._td_zoom[0]      = 0.0f;
+  current_props._td_zoom[1]      = 0.0f;
+  current_props._td_gate[0]      = 0.0f;
+  current_props._td_gate[1]      = 0.0f;
+  current_props._portext_delay   = 0.0f;
+  current_props._portext_loss[0] = 0;
+  current_props._portext_loss[1] = 0;
+  current_props._portext_freq    = 0;
   current_props._velocity_factor = 70;
   current_props._current_trace   = 0;
   current_props._active_marker   = 0;
   current_props._previous_marker = MARKER_INVALID;
   current_props._mode            = 0;
-  current_props._reserved        = 0;
+  current_props._td_beta         = 6;
   current_props._power           = SI5351_CLK_DRIVE_STRENGTH_AUTO;
   current_props._cal_power       = SI5351_CLK_DRIVE_STRENGTH_AUTO;
   current_props._measure         = 0;
@@ -1051,27 +1535,78 @@ duplicate_buffer_to_dump(audio_sample_t *p, size_t n)
 
 // DMA i2s callback function, called on get 'half' and 'full' buffer size data need for process data, while DMA fill next buffer
 static systime_t ready_time = 0;
+static systime_t ready_delay = 0;
+#ifdef __USE_SI5351_LOCK_WAIT__
+// Max DSP buffers count for wait stable signal after band change
+#define DSP_SETTLE_MAX   (DELAY_BAND_SETTLE_MAX * AUDIO_ADC_FREQ_K / 1000 / AUDIO_SAMPLES_COUNT)
+static uint16_t settle_count = 0;
+static float    settle_level;
+#endif
+#if defined(__USE_ADAPTIVE_IFBW__) || defined(__USE_SWEEP_NOISE__)
+#define __USE_DSP_STAT__
+// Collect per buffer statistic, set only in sweep
+static bool dsp_stat_enabled = false;
+#endif
+#ifdef __USE_ADAPTIVE_IFBW__
+// Min DSP buffers count for adaptive IFBW (need for correct variance estimate)
+#define DSP_ADAPTIVE_MIN 4
+// Adaptive IFBW relative error^2 limit (0 for disabled), set only in sweep
+static float dsp_error_limit = 0.0f;
+#endif
 // sweep operation variables
 volatile uint16_t wait_count = 0;
+// DSP buffers count for current measure (bandwidth)
+static uint16_t dsp_bw = 0;
 // i2s buffer must be 2x size (for process one while next buffer filled by DMA)
 static audio_sample_t rx_buffer[AUDIO_BUFFER_LEN * 2];
 
 void i2s_lld_serve_rx_interrupt(uint32_t flags) {
 //if ((flags & (STM32_DMA_ISR_TCIF|STM32_DMA_ISR_HTIF)) == 0) return;
   uint16_t wait = wait_count;
-  if (wait == 0 || chVTGetSystemTimeX() < ready_time) return;
+  if (wait == 0 || i2c_busy() || chVTGetSystemTimeX() < ready_time) return;
   uint16_t count = AUDIO_BUFFER_LEN;
   audio_sample_t *p = (flags & STM32_DMA_ISR_TCIF) ? rx_buffer + AUDIO_BUFFER_LEN : rx_buffer; // Full or Half transfer complete
-  if (wait >= config._bandwidth+2)      // At this moment in buffer exist noise data, reset and wait next clean buffer
+  if (wait >= dsp_bw+2) {              // At this moment in buffer exist noise data, reset and wait next clean buffer
+#ifdef __USE_SI5351_LOCK_WAIT__
+    if (settle_count) {                 // After PLL lock wait stable reference signal level
+      reset_dsp_accumerator();
+      dsp_process(p, count);
+      float level = get_ref_level();
+      float diff = level - settle_level;
+      settle_level = level;
+      if (--settle_count && vna_fabsf(diff) > level * (1.0f/64.0f))
+        return;
+      settle_count = 0;
+    }
+#endif
     reset_dsp_accumerator();
-  else
+  }
+  else {
     dsp_process(p, count);
+#ifdef __USE_DSP_STAT__
+    if (dsp_stat_enabled) {
+      dsp_stat_update();
+#ifdef __USE_ADAPTIVE_IFBW__
+      // Stop integration if measured value error small
+      if (dsp_error_limit > 0.0f && wait + DSP_ADAPTIVE_MIN <= dsp_bw+2 && dsp_stat_converged(dsp_error_limit))
+        wait_count = 1;
+#endif
+    }
+#endif
+  }
 #ifdef ENABLED_DUMP_COMMAND
   duplicate_buffer_to_dump(p, count);
 #endif
   --wait_count;
 }
 
+#ifdef __USE_I2C_DMA__
+// Generator and codec registers send by DMA, delay count from transfer end
+void i2c_lld_serve_tx_end(void) {
+  ready_time = chVTGetSystemTimeX() + ready_delay;
+}
+#endif
+
 #ifdef ENABLE_SI5351_TIMINGS
 extern uint16_t timings[16];
 #undef DELAY_CHANNEL_CHANGE
@@ -1080,7 +1615,11 @@ extern uint16_t timings[16];
 #define DELAY_SWEEP_START     timings[4]
 #endif
 
-#define DSP_START(delay) {ready_time = chVTGetSystemTimeX() + delay; wait_count = config._bandwidth+2;}
+// Skip buffers: ISR reset accumulator on every buffer while wait_count >= bandwidth+2
+#define DSP_START_BW(delay, bw, skip) {ready_delay = delay; ready_time = chVTGetSystemTimeX() + delay; dsp_bw = bw; wait_count = dsp_bw+2+(skip);}
+#define DSP_START(delay) DSP_START_BW(delay, config._bandwidth, 0)
+// Dummy ADC buffers then sweep only one channel (codec mux not switched, need more time for filter settle after generator change)
+#define DSP_SINGLE_CHANNEL_SKIP     1
 #define DSP_WAIT         while (wait_count) {__WFI();}
 #define RESET_SWEEP      {p_sweep = 0;}
 
@@ -1092,11 +1631,16 @@ extern uint16_t timings[16];
 #define SWEEP_APPLY_CALIBRATION     (1<< 5)
 #define SWEEP_USE_INTERPOLATION     (1<< 6)
 #define SWEEP_USE_RENORMALIZATION   (1<< 7)
+#define SWEEP_ADAPTIVE_IFBW         (1<< 8)
+#define SWEEP_MEASURE_NOISE         (1<< 9)
+#define SWEEP_AUTO_IFBW             (1<<10)
+#define SWEEP_USE_AVERAGE           (1<<11)
+#define SWEEP_APPLY_PORT_EXT        (1<<12)
+#define SWEEP_STREAM_OUTPUT         (1<<13)
 
 static uint16_t get_sweep_mask(void){
   uint16_t ch_mask = 0;
-#if 0
-  // Sweep only used channels (FIXME strange bug in 400-500M on switch channels if only 1 Trace)
+  // Sweep only used channels
   int t;
   for (t = 0; t < TRACES_MAX; t++) {
     if (!trace[t].enabled)
@@ -1104,27 +1648,39 @@ static uint16_t get_sweep_mask(void){
     if ((trace[t].channel&1) == 0) ch_mask|= SWEEP_CH0_MEASURE;
     else/*if (trace[t].channel == 1)*/ ch_mask|= SWEEP_CH1_MEASURE;
   }
-#else
-  // sweep 2 channels in any case
-  ch_mask|= SWEEP_CH0_MEASURE|SWEEP_CH1_MEASURE;
-#endif
 
 #ifdef __VNA_MEASURE_MODULE__
   // For measure calculations need data
   ch_mask|= plot_get_measure_channels();
 #endif
 #ifdef __VNA_Z_RENORMALIZATION__
-  if (current_props._portz != cal_load_r)
+  if (current_props._portz != cal_load_r || current_props._portz_x != 0.0f) {
     ch_mask|= SWEEP_USE_RENORMALIZATION;
+    // S21 renormalization need S11 data
+    if (ch_mask & SWEEP_CH1_MEASURE) ch_mask|= SWEEP_CH0_MEASURE;
+  }
 #endif
   if (cal_status & CALSTAT_APPLY)        ch_mask|= SWEEP_APPLY_CALIBRATION;
   if (cal_status & CALSTAT_INTERPOLATED) ch_mask|= SWEEP_USE_INTERPOLATION;
   if (electrical_delayS11)               ch_mask|= SWEEP_APPLY_EDELAY_S11;
   if (electrical_delayS21)               ch_mask|= SWEEP_APPLY_EDELAY_S21;
   if (s21_offset)                        ch_mask|= SWEEP_APPLY_S21_OFFSET;
+#ifdef __USE_PORT_EXTENSION__
+  if (portext_enabled())                 ch_mask|= SWEEP_APPLY_PORT_EXT;
+#endif
+#ifdef __USE_ADAPTIVE_IFBW__
+  if (config._adaptive_ifbw)             ch_mask|= SWEEP_ADAPTIVE_IFBW;
+#endif
+#ifdef __USE_AUTO_IFBW__
+  if (config._auto_ifbw)                 ch_mask|= SWEEP_AUTO_IFBW;
+#endif
+#ifdef __USE_AVERAGE__
+  if (average_count > 1)                 ch_mask|= SWEEP_USE_AVERAGE;
+#endif
   return ch_mask;
 }
 
+#ifndef __USE_EDELAY_ROTATOR__
 static void applyEDelay(float w, float data[2]) {
   float s, c;
   float real = data[0];
@@ -1133,6 +1689,32 @@ static void applyEDelay(float w, float data[2]) {
   data[0] = real * c - imag * s;
   data[1] = imag * c + real * s;
 }
+#endif
+
+#ifdef __USE_EDELAY_ROTATOR__
+#include "vna_modules/vna_edelay.c"
+#define sweep_apply_edelay(ch, delay, idx, freq, data)  applyEDelayPoint(ch, delay, freq, data)
+#else
+#define EDELAY_ROT_PORTEXT  2
+#define sweep_apply_edelay(ch, delay, idx, freq, data)  applyEDelay((delay) * (freq), data)
+#endif
+
+#ifdef __USE_PORT_EXTENSION__
+// Port extension: move reference plane by remove cable/fixture delay and loss
+// Loss model L(f) = L0 + (L1 - L0) * sqrt(f / F1) (DC loss + skin effect), S11 pass extension twice, S21 once
+// Delay applied by e-delay rotator, only loss calculated for every point
+static void applyPortExtension(int ch, freq_t freq, float data[2]) {
+  float n = ch == 0 ? 2.0f : 1.0f;
+  if (portext_delay != 0.0f)
+    sweep_apply_edelay(EDELAY_ROT_PORTEXT + ch, n * portext_delay, 0, freq, data);
+  if (portext_loss[0] == 0 && portext_loss[1] == 0) return;
+  float loss = portext_loss[0];
+  if (portext_freq) loss+= (portext_loss[1] - portext_loss[0]) * vna_sqrtf((float)freq / portext_freq);
+  float g = vna_expf(loss * n * (PORTEXT_LOSS_UNIT * logf(10.0f) / 20.0f));
+  data[0]*= g;
+  data[1]*= g;
+}
+#endif
 
 static void applyOffset(float data[2], float offset){
   data[0]*= offset;
@@ -1143,14 +1725,100 @@ static void applyOffset(float data[2], float offset){
 #include "vna_modules/vna_renorm.c"
 #endif
 
+#ifdef __USE_FREQ_PLAN_CACHE__
+#define sweep_set_frequency(idx, freq)      si5351_set_sweep_frequency(idx, freq, current_props._power)
+#define sweep_prepare_frequency(idx, freq)  si5351_prepare_sweep_frequency(idx, freq, current_props._power)
+#else
+#define si5351_plan_cache_reset()
+#define sweep_set_frequency(idx, freq)      set_frequency(freq)
+#define sweep_prepare_frequency(idx, freq)  si5351_prepare_frequency(freq, current_props._power)
+#endif
+
+#ifdef __USE_AUTO_IFBW__
+// Raw signal level of points on previous sweep (S21 if measured, else S11), stored before any
+// post processing as attenuation in dB + 1 (0 - level unknown, use full bandwidth)
+static uint8_t sweep_level[SWEEP_POINTS_MAX];
+
+// Need call on sweep mask or frequency table change
+static void sweep_level_reset(void) {
+  memset(sweep_level, 0, sizeof(sweep_level));
+}
+
+static void sweep_level_store(uint16_t idx, const float *v) {
+  float att = -vna_log10f_x_10(v[0] * v[0] + v[1] * v[1]);
+  sweep_level[idx] = att < 0.5f ? 1 : att > 253.5f ? 255 : (uint8_t)(att + 1.5f);
+}
+
+// Select point bandwidth by signal level on previous sweep:
+// full bandwidth below auto level, on stronger signal reduce integration time for same SNR
+static uint16_t sweep_auto_bandwidth(void)
+{
+  uint16_t count = config._bandwidth + 1;
+  int db = (int)config._auto_ifbw - (sweep_level[p_sweep] - 1);
+  if (sweep_level[p_sweep] == 0 || db <= 0) return count - 1;
+  count = count * vna_expf(db * (-logf(10.0f) / 10.0f));
+  return count ? count - 1 : 0;
+}
+#else
+#define sweep_level_reset()
+#endif
+
+// Prepare next point data while DSP process current (calculate generator registers and calibration)
+// Return true if calibration data ready
+static bool sweep_prepare_next(uint16_t mask, float c_data[CAL_TYPE_COUNT][2])
+{
+  int next = p_sweep + 1;
+  if (next >= sweep_points)
+    return false;
+  freq_t frequency = getFrequency(next);
+  sweep_prepare_frequency(next, frequency);
+  if ((mask & SWEEP_APPLY_CALIBRATION) == 0)
+    return false;
+  cal_sweep_data(mask, next, frequency, c_data);
+  return true;
+}
+
+#ifdef ENABLE_SCAN_STREAM
+// Scan stream output: out mask and next point for send
+static uint16_t scan_stream_mask;
+static uint16_t scan_stream_next;
+static void scan_output_point(uint16_t mask, int i);
+// Send all ready points before idx (called while DSP measure current point)
+static void scan_stream_output(uint16_t idx)
+{
+  for (; scan_stream_next < idx; scan_stream_next++)
+    scan_output_point(scan_stream_mask, scan_stream_next);
+}
+#endif
+
+#ifdef __USE_I2C_STAT__
+// I2C statistic for last full sweep
+static i2c_stat_t i2c_sweep_stat;
+#endif
+
 // main loop for measurement
 static bool sweep(bool break_on_operation, uint16_t mask)
 {
+  static uint16_t sweep_mask = 0;
+  uint16_t ch_mask = mask & (SWEEP_CH0_MEASURE|SWEEP_CH1_MEASURE);
+  // Restart sweep and averaging on sweep settings change (also no data for new channel on already measured points)
+  if (mask != sweep_mask) {RESET_SWEEP; average_reset(); sweep_level_reset();}
+  sweep_mask = mask;
   if (p_sweep>=sweep_points || break_on_operation == false) RESET_SWEEP;
   if (break_on_operation && mask == 0)
     return false;
+  // Only one channel: select codec input once (no I2C transfers to codec in sweep), and
+  // skip more ADC buffers after generator change (in 2 channel mode switch mux give this time)
+  int skip = 0;
+  if (ch_mask == SWEEP_CH0_MEASURE || ch_mask == SWEEP_CH1_MEASURE) {
+    tlv320aic3204_select(ch_mask == SWEEP_CH1_MEASURE ? 1 : 0);
+    skip = DSP_SINGLE_CHANNEL_SKIP;
+  }
   float data[4];
-  float c_data[CAL_TYPE_COUNT][2];
+  // Double buffer for calibration data: current point and prepared for next
+  float c_buf[2][CAL_TYPE_COUNT][2];
+  float (*c_data)[2] = c_buf[0];
+  bool  c_ready = false;
   // Blink LED while scanning
   palClearPad(GPIOC, GPIOC_LED);
   int delay = 0;
@@ -1160,65 +1828,163 @@ static bool sweep(bool break_on_operation, uint16_t mask)
   // Wait some time for stable power
   int st_delay = DELAY_SWEEP_START;
   int bar_start = 0;
-  int interpolation_idx;
+#ifdef __USE_ADAPTIVE_IFBW__
+  // Relative error limit: 10^(-dB/10) for compare with error^2
+  if (mask & SWEEP_ADAPTIVE_IFBW) dsp_error_limit = vna_expf(config._adaptive_ifbw * (-logf(10.0f) / 10.0f));
+#endif
+#ifdef __USE_DSP_STAT__
+  dsp_stat_enabled = (mask & (SWEEP_ADAPTIVE_IFBW|SWEEP_MEASURE_NOISE)) != 0;
+#endif
+  uint16_t bw = config._bandwidth;
+#ifdef __USE_AVERAGE__
+  float avg_k = (mask & SWEEP_USE_AVERAGE) ? average_factor() : 1.0f;
+#endif
+#ifdef __USE_I2C_STAT__
+  if (p_sweep == 0) memset(&i2c_stat, 0, sizeof(i2c_stat));
+#endif
+  ccm_cache_update();
+#ifdef __USE_EDELAY_ROTATOR__
+  edelay_df = sweep_points > 1 ? (getFrequency(sweep_points - 1) - getFrequency(0)) / (sweep_points - 1) : 0;
+#endif
+#ifdef __USE_SWEEP_NOISE__
+  // Noise measured and stored in CCM buffer only on noise scan (sweep caches there become invalid)
+  float (*noise)[SWEEP_POINTS_MAX] = (mask & SWEEP_MEASURE_NOISE) ? (float (*)[SWEEP_POINTS_MAX])ccm_buffer_work() : NULL;
+  float p_noise[2] = {0.0f, 0.0f};
+#endif
+#ifdef __USE_CAL_INTERP_CACHE__
+  // Prepare calibration interpolation table for sweep points (if frequencies changed)
+  if ((mask & (SWEEP_APPLY_CALIBRATION|SWEEP_USE_INTERPOLATION)) == (SWEEP_APPLY_CALIBRATION|SWEEP_USE_INTERPOLATION) && SWEEP_CACHE_ENABLED(mask))
+    cal_interpolate_update();
+#endif
+#ifdef __VNA_Z_RENORMALIZATION__
+  // Prepare renormalization coefficients (if port impedance changed)
+  if (mask & SWEEP_USE_RENORMALIZATION)
+    renorm_update();
+#endif
+#ifdef __USE_FREQ_PLAN_CACHE__
+  // Prepare generator registers for all sweep points (if frequencies or settings changed)
+  if (p_sweep == 0 && (mask & (SWEEP_CH0_MEASURE|SWEEP_CH1_MEASURE)) && SWEEP_CACHE_ENABLED(mask))
+    si5351_plan_cache_build(sweep_points, getFrequency, current_props._power);
+#endif
 
   for (; p_sweep < sweep_points; p_sweep++) {
     freq_t frequency = getFrequency(p_sweep);
     // Need made measure - set frequency
+    bool next_ready = false;
     if (mask & (SWEEP_CH0_MEASURE|SWEEP_CH1_MEASURE)) {
-      delay = set_frequency(frequency);
-      interpolation_idx = mask & SWEEP_USE_INTERPOLATION ? -1 : p_sweep;
+      delay = sweep_set_frequency(p_sweep, frequency);
     }
+#ifdef __USE_AUTO_IFBW__
+    if (mask & SWEEP_AUTO_IFBW) bw = sweep_auto_bandwidth();
+#endif
+#ifdef __USE_SI5351_LOCK_WAIT__
+    // Band changed and PLL locked, need check signal stability on first channel
+    if (si5351_pll_relocked()) {settle_level = 0.0f; settle_count = DSP_SETTLE_MAX;}
+#endif
     // CH0:REFLECTION, reset and begin measure
     if (mask & SWEEP_CH0_MEASURE) {
-      tlv320aic3204_select(0);
-      DSP_START(delay+st_delay);
-      delay = DELAY_CHANNEL_CHANGE;
-      // Get calibration data
-      if (mask & SWEEP_APPLY_CALIBRATION)
-        cal_interpolate(interpolation_idx, frequency, c_data);
-      //================================================
-      // Place some code thats need execute while delay
-      //================================================
+      if (skip == 0) tlv320aic3204_select(0);
+      DSP_START_BW(delay+st_delay, bw, skip);
+      delay = DELAY_CHANNEL_SWITCH;
+      // Get calibration data (if not prepared on previous point)
+      if ((mask & SWEEP_APPLY_CALIBRATION) && !c_ready)
+        cal_sweep_data(mask, p_sweep, frequency, c_data);
+      // Last channel, prepare next point
+      if (!(mask & SWEEP_CH1_MEASURE)) {
+        next_ready = sweep_prepare_next(mask, c_data == c_buf[0] ? c_buf[1] : c_buf[0]);
+#ifdef ENABLE_SCAN_STREAM
+        if (mask & SWEEP_STREAM_OUTPUT) scan_stream_output(p_sweep);
+#endif
+      }
       DSP_WAIT;
       (*sample_func)(&data[0]);             // calculate reflection coefficient
-      if (mask & SWEEP_APPLY_CALIBRATION)   // Apply calibration
+#ifdef __USE_SWEEP_NOISE__
+      float n[4] = {data[0], data[1]};
+      if (noise) {p_noise[0] = dsp_stat_error(); n[0]+= p_noise[0];}
+#endif
+      if (mask & SWEEP_APPLY_CALIBRATION) { // Apply calibration
         apply_CH0_error_term(data, c_data);
+#ifdef __USE_SWEEP_NOISE__
+        if (noise) {                        // Noise after calibration: |cal(gamma + noise) - cal(gamma)|
+          apply_CH0_error_term(n, c_data);
+          p_noise[0] = vna_sqrtf((n[0] - data[0]) * (n[0] - data[0]) + (n[1] - data[1]) * (n[1] - data[1]));
+        }
+#endif
+      }
     }
     // CH1:TRANSMISSION, reset and begin measure
     if (mask & SWEEP_CH1_MEASURE) {
-      tlv320aic3204_select(1);
-      DSP_START(delay+st_delay);
+      if (skip == 0) tlv320aic3204_select(1);
+      DSP_START_BW(delay+st_delay, bw, skip);
       // Get calibration data, only if not do this in 0 channel wait
-      if ((mask & SWEEP_APPLY_CALIBRATION) && !(mask & SWEEP_CH0_MEASURE))
-        cal_interpolate(interpolation_idx, frequency, c_data);
-      //================================================
-      // Place some code thats need execute while delay
-      //================================================
+      if ((mask & SWEEP_APPLY_CALIBRATION) && !(mask & SWEEP_CH0_MEASURE) && !c_ready)
+        cal_sweep_data(mask, p_sweep, frequency, c_data);
+      // Last channel, prepare next point
+      next_ready = sweep_prepare_next(mask, c_data == c_buf[0] ? c_buf[1] : c_buf[0]);
+#ifdef ENABLE_SCAN_STREAM
+      if (mask & SWEEP_STREAM_OUTPUT) scan_stream_output(p_sweep);
+#endif
       DSP_WAIT;
       (*sample_func)(&data[2]);              // Measure transmission coefficient
-      if (mask & SWEEP_APPLY_CALIBRATION)    // Apply calibration
+#ifdef __USE_SWEEP_NOISE__
+      float n[4] = {data[0], data[1], data[2], data[3]};
+      if (noise) {p_noise[1] = dsp_stat_error(); n[2]+= p_noise[1];}
+#endif
+      if (mask & SWEEP_APPLY_CALIBRATION) {  // Apply calibration
         apply_CH1_error_term(data, c_data);
+#ifdef __USE_SWEEP_NOISE__
+        if (noise) {
+          apply_CH1_error_term(n, c_data);
+          p_noise[1] = vna_sqrtf((n[2] - data[2]) * (n[2] - data[2]) + (n[3] - data[3]) * (n[3] - data[3]));
+        }
+#endif
+      }
     }
+#ifdef __USE_AUTO_IFBW__
+    if ((mask & SWEEP_AUTO_IFBW) && ch_mask)
+      sweep_level_store(p_sweep, &data[(mask & SWEEP_CH1_MEASURE) ? 2 : 0]);
+#endif
+#ifdef __USE_PORT_EXTENSION__
+    if (mask & SWEEP_APPLY_PORT_EXT) {
+      if (mask & SWEEP_CH0_MEASURE) applyPortExtension(0, frequency, &data[0]);
+      if (mask & SWEEP_CH1_MEASURE) applyPortExtension(1, frequency, &data[2]);
+    }
+#endif
 #ifdef __VNA_Z_RENORMALIZATION__
     if (mask & SWEEP_USE_RENORMALIZATION)
       apply_renormalization(data, mask);
 #endif
     if (p_sweep < SWEEP_POINTS_MAX){
       if (mask & SWEEP_CH0_MEASURE) {
-        if (mask & SWEEP_APPLY_EDELAY_S11) applyEDelay(electrical_delayS11 * frequency, &data[0]); // Apply e-delay
+        if (mask & SWEEP_APPLY_EDELAY_S11) sweep_apply_edelay(0, electrical_delayS11, p_sweep, frequency, &data[0]); // Apply e-delay
+#ifdef __USE_AVERAGE__
+        if (mask & SWEEP_USE_AVERAGE) average_point(average_data[0][p_sweep], &data[0], avg_k);
+#endif
         measured[0][p_sweep][0] = data[0];
         measured[0][p_sweep][1] = data[1];
+#ifdef __USE_SWEEP_NOISE__
+        if (noise) noise[0][p_sweep] = p_noise[0];
+#endif
       }
       if (mask & SWEEP_CH1_MEASURE) {
-        if (mask & SWEEP_APPLY_EDELAY_S21) applyEDelay(electrical_delayS21 * frequency, &data[2]); // Apply e-delay
+        if (mask & SWEEP_APPLY_EDELAY_S21) sweep_apply_edelay(1, electrical_delayS21, p_sweep, frequency, &data[2]); // Apply e-delay
         if (mask & SWEEP_APPLY_S21_OFFSET) applyOffset(&data[2], offset);
+#ifdef __USE_AVERAGE__
+        if (mask & SWEEP_USE_AVERAGE) average_point(average_data[1][p_sweep], &data[2], avg_k);
+#endif
         measured[1][p_sweep][0] = data[2];
         measured[1][p_sweep][1] = data[3];
+#ifdef __USE_SWEEP_NOISE__
+        if (noise) noise[1][p_sweep] = (mask & SWEEP_APPLY_S21_OFFSET) ? p_noise[1] * offset : p_noise[1];
+#endif
       }
     }
     if (operation_requested && break_on_operation) break;
     st_delay = 0;
+    // Switch to prepared calibration data
+    c_ready = next_ready;
+    if (c_ready)
+      c_data = c_data == c_buf[0] ? c_buf[1] : c_buf[0];
     // Display SPI made noise on measurement (can see in CW mode), use reduced update
     if (config._bandwidth >= BANDWIDTH_100){
       int current_bar =  (p_sweep * WIDTH)/(sweep_points-1);
@@ -1236,7 +2002,21 @@ static bool sweep(bool break_on_operation, uint16_t mask)
 //  STOP_PROFILE;
   // blink LED while scanning
   palSetPad(GPIOC, GPIOC_LED);
-  return p_sweep == sweep_points;
+#ifdef __USE_ADAPTIVE_IFBW__
+  dsp_error_limit = 0.0f;
+#endif
+#ifdef __USE_DSP_STAT__
+  dsp_stat_enabled = false;
+#endif
+  bool completed = p_sweep == sweep_points;
+#ifdef __USE_I2C_STAT__
+  if (completed) i2c_sweep_stat = i2c_stat;
+#endif
+#ifdef __USE_AVERAGE__
+  // In block mode data ready only after all sweeps averaged
+  if (completed && (mask & SWEEP_USE_AVERAGE)) completed = average_done();
+#endif
+  return completed;
 }
 
 #ifdef ENABLED_DUMP_COMMAND
@@ -1286,6 +2066,7 @@ static int set_frequency(freq_t freq)
 
 void set_bandwidth(uint16_t bw_count){
   config._bandwidth = bw_count&0x1FF;
+  average_reset();
   request_to_redraw(REDRAW_BACKUP | REDRAW_FREQUENCY);
 }
 
@@ -1293,6 +2074,36 @@ uint32_t get_bandwidth_frequency(uint16_t bw_freq){
   return (AUDIO_ADC_FREQ/AUDIO_SAMPLES_COUNT)/(bw_freq+1);
 }
 
+#ifdef __USE_ADAPTIVE_IFBW__
+// Adaptive IFBW: point integration stop then relative error of measured value less then limit (bandwidth used as max time)
+VNA_SHELL_FUNCTION(cmd_adaptive)
+{
+  if (argc == 1) {
+    int db = get_str_index(argv[0], "off") == 0 ? 0 : my_atoi(argv[0]);
+    if (db < 0) db = -db;
+    if (db > 100) db = 100;
+    config._adaptive_ifbw = db;
+  }
+  if (config._adaptive_ifbw) shell_printf("adaptive -%ddB" VNA_SHELL_NEWLINE_STR, config._adaptive_ifbw);
+  else shell_printf("adaptive off" VNA_SHELL_NEWLINE_STR "usage: adaptive {off|error dB}" VNA_SHELL_NEWLINE_STR);
+}
+#endif
+
+#ifdef __USE_AUTO_IFBW__
+// Auto IFBW: point bandwidth select by previous sweep signal level, full bandwidth used only for signal less then level
+VNA_SHELL_FUNCTION(cmd_autobw)
+{
+  if (argc == 1) {
+    int db = get_str_index(argv[0], "off") == 0 ? 0 : my_atoi(argv[0]);
+    if (db < 0) db = -db;
+    if (db > 120) db = 120;
+    config._auto_ifbw = db;
+  }
+  if (config._auto_ifbw) shell_printf("autobw -%ddB" VNA_SHELL_NEWLINE_STR, config._auto_ifbw);
+  else shell_printf("autobw off" VNA_SHELL_NEWLINE_STR "usage: autobw {off|level dB}" VNA_SHELL_NEWLINE_STR);
+}
+#endif
+
 #define MAX_BANDWIDTH      (AUDIO_ADC_FREQ/AUDIO_SAMPLES_COUNT)
 #define MIN_BANDWIDTH      ((AUDIO_ADC_FREQ/AUDIO_SAMPLES_COUNT)/512 + 1)
 
@@ -1344,6 +2155,9 @@ set_frequencies(freq_t start, freq_t stop, uint16_t points)
   // disable at out of sweep range
   for (; i < SWEEP_POINTS_MAX; i++)
     frequencies[i] = 0;
+  si5351_plan_cache_reset();
+  cal_interpolate_reset();
+  sweep_level_reset();
 }
 #define _c_start    frequencies[0]
 #define _c_stop     frequencies[sweep_points-1]
@@ -1364,6 +2178,9 @@ set_frequencies(freq_t start, freq_t stop, uint16_t points)
   _f_points = (points - 1);
   _f_delta  = span / _f_points;
   _f_error  = span % _f_points;
+  si5351_plan_cache_reset();
+  cal_interpolate_reset();
+  sweep_level_reset();
 }
 freq_t getFrequency(uint16_t idx) {return _f_start + _f_delta * idx + (_f_points / 2 + _f_error * idx) / _f_points;}
 freq_t getFrequencyStep(void) {return _f_delta;}
@@ -1379,12 +2196,51 @@ static bool needInterpolate(freq_t start, freq_t stop, uint16_t points){
 #define SCAN_MASK_NO_CALIBRATION 0b00001000
 #define SCAN_MASK_NO_EDELAY      0b00010000
 #define SCAN_MASK_NO_S21OFFS     0b00100000
+#define SCAN_MASK_OUT_NOISE      0b01000000
 #define SCAN_MASK_BINARY         0b10000000
+#define SCAN_MASK_STREAM        0b100000000
+
+// Output one scan point (text or binary)
+static void scan_output_point(uint16_t mask, int i)
+{
+  if (mask&SCAN_MASK_BINARY){
+    if (mask & SCAN_MASK_OUT_FREQ ) {freq_t f = getFrequency(i); shell_write(&f, sizeof(freq_t));} // 4 bytes .. frequency
+    if (mask & SCAN_MASK_OUT_DATA0) shell_write(&measured[0][i][0], sizeof(float)* 2);             // 4+4 bytes .. S11 real/imag
+    if (mask & SCAN_MASK_OUT_DATA1) shell_write(&measured[1][i][0], sizeof(float)* 2);             // 4+4 bytes .. S21 real/imag
+#ifdef __USE_SWEEP_NOISE__
+    if ((mask & (SCAN_MASK_OUT_NOISE|SCAN_MASK_OUT_DATA0)) == (SCAN_MASK_OUT_NOISE|SCAN_MASK_OUT_DATA0))
+      shell_write(&measured_noise[0][i], sizeof(float));                                          // 4 bytes .. S11 noise
+    if ((mask & (SCAN_MASK_OUT_NOISE|SCAN_MASK_OUT_DATA1)) == (SCAN_MASK_OUT_NOISE|SCAN_MASK_OUT_DATA1))
+      shell_write(&measured_noise[1][i], sizeof(float));                                          // 4 bytes .. S21 noise
+#endif
+  } else {
+    if (mask & SCAN_MASK_OUT_FREQ ) shell_printf(VNA_FREQ_FMT_STR " ", getFrequency(i));
+    if (mask & SCAN_MASK_OUT_DATA0) shell_printf("%f %f ", measured[0][i][0], measured[0][i][1]);
+    if (mask & SCAN_MASK_OUT_DATA1) shell_printf("%f %f ", measured[1][i][0], measured[1][i][1]);
+#ifdef __USE_SWEEP_NOISE__
+    if (mask & SCAN_MASK_OUT_NOISE) {
+      if (mask & SCAN_MASK_OUT_DATA0) shell_printf("%f ", measured_noise[0][i]);
+      if (mask & SCAN_MASK_OUT_DATA1) shell_printf("%f ", measured_noise[1][i]);
+    }
+#endif
+    shell_printf(VNA_SHELL_NEWLINE_STR);
+  }
+}
+
+// Long scan (more then SWEEP_POINTS_MAX points, need out mask) measured by chunks, measured buffer reused
+#define SCAN_POINTS_MAX          65535
+
+// Scan point frequency (same as getFrequency for full scan range)
+static freq_t scan_frequency(freq_t start, freq_t stop, uint16_t points, uint16_t idx)
+{
+  if (points < 2) return start;
+  return start + (freq_t)(((uint64_t)(stop - start) * idx + (points - 1) / 2) / (points - 1));
+}
 
 VNA_SHELL_FUNCTION(cmd_scan)
 {
   freq_t start, stop;
-  uint16_t points = sweep_points;
+  uint32_t points = sweep_points;
   if (argc < 2 || argc > 4) {
     shell_printf("usage: scan {start(Hz)} {stop(Hz)} [points] [outmask]" VNA_SHELL_NEWLINE_STR);
     return;
@@ -1396,14 +2252,8 @@ VNA_SHELL_FUNCTION(cmd_scan)
       shell_printf("frequency range is invalid" VNA_SHELL_NEWLINE_STR);
       return;
   }
-  if (argc >= 3) {
+  if (argc >= 3)
     points = my_atoui(argv[2]);
-    if (points == 0 || points > SWEEP_POINTS_MAX) {
-      shell_printf("sweep points exceeds range " define_to_STR(SWEEP_POINTS_MAX) VNA_SHELL_NEWLINE_STR);
-      return;
-    }
-    sweep_points = points;
-  }
   uint16_t mask = 0;
   uint16_t sweep_ch = SWEEP_CH0_MEASURE|SWEEP_CH1_MEASURE;
 
@@ -1420,39 +2270,80 @@ VNA_SHELL_FUNCTION(cmd_scan)
     sweep_ch = (mask>>1)&3;
   }
 #endif
+  // Without output only one sweep allowed
+  if (points == 0 || points > (mask ? SCAN_POINTS_MAX : SWEEP_POINTS_MAX)) {
+    shell_printf("sweep points exceeds range %u" VNA_SHELL_NEWLINE_STR, mask ? SCAN_POINTS_MAX : SWEEP_POINTS_MAX);
+    return;
+  }
 
   if ((cal_status & CALSTAT_APPLY) && !(mask&SCAN_MASK_NO_CALIBRATION)) sweep_ch|= SWEEP_APPLY_CALIBRATION;
   if (electrical_delayS11          && !(mask&SCAN_MASK_NO_EDELAY     )) sweep_ch|= SWEEP_APPLY_EDELAY_S11;
   if (electrical_delayS21          && !(mask&SCAN_MASK_NO_EDELAY     )) sweep_ch|= SWEEP_APPLY_EDELAY_S21;
   if (s21_offset                   && !(mask&SCAN_MASK_NO_S21OFFS    )) sweep_ch|= SWEEP_APPLY_S21_OFFSET;
+#ifdef __USE_PORT_EXTENSION__
+  if (portext_enabled()            && !(mask&SCAN_MASK_NO_EDELAY     )) sweep_ch|= SWEEP_APPLY_PORT_EXT;
+#endif
+#ifdef __USE_SWEEP_NOISE__
+  if (mask&SCAN_MASK_OUT_NOISE) sweep_ch|= SWEEP_MEASURE_NOISE;
+#endif
+#ifdef __USE_ADAPTIVE_IFBW__
+  if (config._adaptive_ifbw) sweep_ch|= SWEEP_ADAPTIVE_IFBW;
+#endif
+#ifdef __USE_AUTO_IFBW__
+  if (config._auto_ifbw)     sweep_ch|= SWEEP_AUTO_IFBW;
+#endif
 
-  if (needInterpolate(start, stop, sweep_points))
-    sweep_ch|= SWEEP_USE_INTERPOLATION;
-
-  sweep_points = points;
-  set_frequencies(start, stop, points);
-  if (sweep_ch & (SWEEP_CH0_MEASURE|SWEEP_CH1_MEASURE))
-    sweep(false, sweep_ch);
-  pause_sweep();
-  // Output data after if set (faster data receive)
-  if (mask) {
-    if (mask&SCAN_MASK_BINARY){
-      shell_write(&mask, sizeof(uint16_t));
-      shell_write(&points, sizeof(uint16_t));
-      for (int i = 0; i < points; i++) {
-        if (mask & SCAN_MASK_OUT_FREQ ) {freq_t f = getFrequency(i); shell_write(&f, sizeof(freq_t));} // 4 bytes .. frequency
-        if (mask & SCAN_MASK_OUT_DATA0) shell_write(&measured[0][i][0], sizeof(float)* 2);             // 4+4 bytes .. S11 real/imag
-        if (mask & SCAN_MASK_OUT_DATA1) shell_write(&measured[1][i][0], sizeof(float)* 2);             // 4+4 bytes .. S21 real/imag
-      }
-    } else {
-      for (int i = 0; i < points; i++) {
-        if (mask & SCAN_MASK_OUT_FREQ ) shell_printf(VNA_FREQ_FMT_STR " ", getFrequency(i));
-        if (mask & SCAN_MASK_OUT_DATA0) shell_printf("%f %f ", measured[0][i][0], measured[0][i][1]);
-        if (mask & SCAN_MASK_OUT_DATA1) shell_printf("%f %f ", measured[1][i][0], measured[1][i][1]);
-        shell_printf(VNA_SHELL_NEWLINE_STR);
-      }
-    }
+  if (mask == 0) {
+    if (needInterpolate(start, stop, points))
+      sweep_ch|= SWEEP_USE_INTERPOLATION;
+    sweep_points = points;
+    set_frequencies(start, stop, points);
+    if (sweep_ch & (SWEEP_CH0_MEASURE|SWEEP_CH1_MEASURE))
+      sweep(false, sweep_ch);
+    pause_sweep();
+    return;
+  }
+  // Binary header (points data follow)
+  if (mask&SCAN_MASK_BINARY){
+    uint16_t total = points;
+    shell_write(&mask, sizeof(uint16_t));
+    shell_write(&total, sizeof(uint16_t));
+  }
+#ifdef ENABLE_SCAN_STREAM
+  // Stream mode: send measured points while DSP measure next
+  if (mask&SCAN_MASK_STREAM) {
+    scan_stream_mask = mask;
+    sweep_ch|= SWEEP_STREAM_OUTPUT;
   }
+#endif
+  // Split scan to equal chunks, chunk frequencies set on full scan grid
+  uint16_t chunks = (points + SWEEP_POINTS_MAX - 1) / SWEEP_POINTS_MAX;
+  uint16_t from = 0;
+  for (uint16_t c = 1; c <= chunks; c++) {
+    uint16_t to = points * c / chunks;
+    uint16_t n = to - from;
+    freq_t f0 = scan_frequency(start, stop, points, from);
+    freq_t f1 = scan_frequency(start, stop, points, to - 1);
+    uint16_t ch = sweep_ch;
+    if (needInterpolate(f0, f1, n))
+      ch|= SWEEP_USE_INTERPOLATION;
+    sweep_points = n;
+    set_frequencies(f0, f1, n);
+    int i = 0;
+#ifdef ENABLE_SCAN_STREAM
+    scan_stream_next = 0;
+#endif
+    if (ch & (SWEEP_CH0_MEASURE|SWEEP_CH1_MEASURE))
+      sweep(false, ch);
+#ifdef ENABLE_SCAN_STREAM
+    i = scan_stream_next;
+#endif
+    // Output data after if set (faster data receive), in stream mode only not send points
+    for (; i < n; i++)
+      scan_output_point(mask, i);
+    from = to;
+  }
+  pause_sweep();
 }
 
 #ifdef ENABLE_SCANBIN_COMMAND
@@ -1536,6 +2427,7 @@ update_frequencies(void)
 
   request_to_redraw(REDRAW_BACKUP | REDRAW_PLOT | REDRAW_CAL_STATUS | REDRAW_FREQUENCY | REDRAW_AREA);
   RESET_SWEEP;
+  average_reset();
 }
 
 void
@@ -1897,27 +2789,20 @@ cal_collect(uint16_t type)
   uint16_t mask = (src == 0) ? SWEEP_CH0_MEASURE : SWEEP_CH1_MEASURE;
 //  if (electrical_delayS11) mask|= SWEEP_APPLY_EDELAY_S11;
 //  if (electrical_delayS21) mask|= SWEEP_APPLY_EDELAY_S21;
-  // Measure calibration data
+  // Measure and copy calibration data
   sweep(false, mask);
-  // Copy calibration data
   memcpy(cal_data[dst], measured[src], sizeof measured[0]);
-
-  // Made average if need
-  int count = 1, i, j;
-  for (i = 1; i < count; i ++){
-    sweep(false, (src == 0) ? SWEEP_CH0_MEASURE : SWEEP_CH1_MEASURE);
-    for (j = 0; j < sweep_points; j++){
-      cal_data[dst][j][0]+=measured[src][j][0];
-      cal_data[dst][j][1]+=measured[src][j][1];
-    }
-  }
-  if (i != 1){
-    float k = 1.0f / i;
-    for (j = 0; j < sweep_points; j++){
-      cal_data[dst][j][0]*= k;
-      cal_data[dst][j][1]*= k;
+#ifdef __USE_AVERAGE__
+  // Average in calibration data (float precision)
+  for (int n = 2; n <= average_count; n++) {
+    sweep(false, mask);
+    float k = 1.0f / n;
+    for (int i = 0; i < sweep_points; i++) {
+      cal_data[dst][i][0]+= (measured[src][i][0] - cal_data[dst][i][0]) * k;
+      cal_data[dst][i][1]+= (measured[src][i][1] - cal_data[dst][i][1]) * k;
     }
   }
+#endif
 
   config._bandwidth = bw;          // restore
   request_to_redraw(REDRAW_CAL_STATUS);
@@ -1964,11 +2849,24 @@ cal_done(void)
   request_to_redraw(REDRAW_BACKUP | REDRAW_CAL_STATUS);
 }
 
-static void cal_interpolate(int idx, freq_t f, float data[CAL_TYPE_COUNT][2]){
-  int eterm;
+#ifdef __USE_CAL_CUBIC_INTERP__
+// Interpolation index flags: exist previous and next calibration points in same harmonic band (allow cubic interpolation)
+#define CAL_INTERP_PREV     0x4000
+#define CAL_INTERP_NEXT     0x8000
+#define CAL_INTERP_IDX      0x3FFF
+
+// Return calibration point frequency
+static freq_t cal_point_frequency(int idx){
   uint16_t src_points = cal_sweep_points - 1;
-  if (idx >= 0)
-    goto copy_point;
+  return cal_frequency0 + ((uint64_t)(cal_frequency1 - cal_frequency0) * idx + src_points/2) / src_points;
+}
+#endif
+
+// Calculate calibration point index and interpolation k for frequency (k == 0 for direct point copy)
+static int cal_interpolate_k(freq_t f, float *k_out){
+  uint16_t src_points = cal_sweep_points - 1;
+  float k = 0.0f;
+  int idx;
   if (f <= cal_frequency0){
     idx = 0;
     goto copy_point;
@@ -1988,36 +2886,137 @@ static void cal_interpolate(int idx, freq_t f, float data[CAL_TYPE_COUNT][2]){
   // Not need interpolate
   if (f == src_f0) goto copy_point;
 
-  float k = (delta == 0) ? 0.0f : (float)(f - src_f0) / delta;
+  k = (delta == 0) ? 0.0f : (float)(f - src_f0) / delta;
   // avoid glitch between freqs in different harmonics mode
   uint32_t hf0 = si5351_get_harmonic_lvl(src_f0);
   if (hf0 != si5351_get_harmonic_lvl(src_f1)) {
     // f in prev harmonic, need extrapolate from prev 2 points
     if (hf0 == si5351_get_harmonic_lvl(f)){
-      if (idx < 1) goto copy_point; // point limit
+      if (idx < 1) {k = 0.0f; goto copy_point;} // point limit
       idx--;
       k+= 1.0f;
     }
     // f in next harmonic, need extrapolate from next 2 points
     else {
-      if (idx >= src_points) goto copy_point; // point limit
+      if (idx >= src_points) {k = 0.0f; goto copy_point;} // point limit
       idx++;
       k-= 1.0f;
     }
   }
+#ifdef __USE_CAL_CUBIC_INTERP__
+  // Cubic interpolation need 2 points around in same harmonic band
+  else {
+    if (idx >= 1              && si5351_get_harmonic_lvl(cal_point_frequency(idx-1)) == hf0) idx|= CAL_INTERP_PREV;
+    if (idx + 2 <= src_points && si5351_get_harmonic_lvl(cal_point_frequency(idx+2)) == hf0) idx|= CAL_INTERP_NEXT;
+  }
+#endif
+copy_point:
+  *k_out = k;
+  return idx;
+}
+
+// Interpolate calibration data by point index and k
+static void cal_interpolate_apply(int idx, float k, float data[CAL_TYPE_COUNT][2]){
+  int eterm;
+#ifdef __USE_CAL_CUBIC_INTERP__
+  if ((idx & (CAL_INTERP_PREV|CAL_INTERP_NEXT)) == (CAL_INTERP_PREV|CAL_INTERP_NEXT)) {
+    // Cubic (Catmull-Rom spline) interpolation on 4 points, weights calculated once for all terms
+    idx&= CAL_INTERP_IDX;
+    float k2 = k * k, k3 = k2 * k;
+    float w0 = 0.5f * (-k3 + 2.0f * k2 - k);
+    float w1 = 0.5f * ( 3.0f * k3 - 5.0f * k2) + 1.0f;
+    float w2 = 0.5f * (-3.0f * k3 + 4.0f * k2 + k);
+    float w3 = 0.5f * ( k3 - k2);
+    for (eterm = 0; eterm < CAL_TYPE_COUNT; eterm++) {
+      float (*c)[2] = &cal_data[eterm][idx-1];
+      data[eterm][0] = w0 * c[0][0] + w1 * c[1][0] + w2 * c[2][0] + w3 * c[3][0];
+      data[eterm][1] = w0 * c[0][1] + w1 * c[1][1] + w2 * c[2][1] + w3 * c[3][1];
+    }
+    return;
+  }
+  idx&= CAL_INTERP_IDX;
+#endif
+  if (k == 0.0f) {
+    // Direct point copy
+    for (eterm = 0; eterm < CAL_TYPE_COUNT; eterm++) {
+      data[eterm][0] = cal_data[eterm][idx][0];
+      data[eterm][1] = cal_data[eterm][idx][1];
+    }
+    return;
+  }
   // Interpolate by k
   for (eterm = 0; eterm < CAL_TYPE_COUNT; eterm++) {
     data[eterm][0] = cal_data[eterm][idx][0] + k * (cal_data[eterm][idx+1][0] - cal_data[eterm][idx][0]);
     data[eterm][1] = cal_data[eterm][idx][1] + k * (cal_data[eterm][idx+1][1] - cal_data[eterm][idx][1]);
   }
-  return;
-  // Direct point copy
-copy_point:
-  for (eterm = 0; eterm < CAL_TYPE_COUNT; eterm++) {
-    data[eterm][0] = cal_data[eterm][idx][0];
-    data[eterm][1] = cal_data[eterm][idx][1];
+}
+
+#ifdef __USE_CAL_INTERP_CACHE__
+// Interpolation cache for sweep points: calibration point index (and cubic flags) and k (fixed point), depend only from
+// sweep frequencies, calibration frequencies and harmonic threshold, so calculated once for frequency list
+#define CAL_INTERP_K_SCALE  8192.0f
+static struct {
+  freq_t   cal_start;
+  freq_t   cal_stop;
+  uint16_t cal_points;
+  uint16_t points;              // cached points count (0 - cache invalid)
+  uint32_t threshold;
+} cal_interp;
+// Cache points placed in CCM buffer
+typedef struct {
+  uint16_t idx;
+  int16_t  k;
+} cal_interp_point_t;
+_Static_assert(sizeof(cal_interp_point_t) * SWEEP_POINTS_MAX <= CAL_INTERP_CACHE_SIZE, "cal interpolation cache bigger then CAL_INTERP_CACHE_SIZE");
+#define cal_interp_p  ((cal_interp_point_t *)ccm_buffer)
+
+static void cal_interpolate_reset(void){
+  cal_interp.points = 0;
+}
+
+// Check and rebuild cache for current sweep frequencies
+static void cal_interpolate_update(void){
+  if (cal_interp.points    == sweep_points
+   && cal_interp.cal_start == cal_frequency0
+   && cal_interp.cal_stop  == cal_frequency1
+   && cal_interp.cal_points== cal_sweep_points
+   && cal_interp.threshold == config._harmonic_freq_threshold)
+    return;
+  int i;
+  for (i = 0; i < sweep_points && i < SWEEP_POINTS_MAX; i++) {
+    float k;
+    cal_interp_p[i].idx = cal_interpolate_k(getFrequency(i), &k);
+    cal_interp_p[i].k   = k * CAL_INTERP_K_SCALE;
   }
-  return;
+  cal_interp.cal_start = cal_frequency0;
+  cal_interp.cal_stop  = cal_frequency1;
+  cal_interp.cal_points= cal_sweep_points;
+  cal_interp.threshold = config._harmonic_freq_threshold;
+  cal_interp.points    = i;
+}
+#endif
+
+// Get calibration data for point (idx >= 0) or frequency (idx < 0)
+static void cal_interpolate(int idx, freq_t f, float data[CAL_TYPE_COUNT][2]){
+  float k = 0.0f;
+  if (idx < 0)
+    idx = cal_interpolate_k(f, &k);
+  cal_interpolate_apply(idx, k, data);
+}
+
+// Get calibration data for sweep point (use interpolation cache if possible)
+static void cal_sweep_data(uint16_t mask, int idx, freq_t f, float data[CAL_TYPE_COUNT][2]){
+  if (!(mask & SWEEP_USE_INTERPOLATION)) {
+    cal_interpolate_apply(idx, 0.0f, data);
+    return;
+  }
+#ifdef __USE_CAL_INTERP_CACHE__
+  if (idx < cal_interp.points) {
+    cal_interpolate_apply(cal_interp_p[idx].idx, cal_interp_p[idx].k * (1.0f / CAL_INTERP_K_SCALE), data);
+    return;
+  }
+#endif
+  cal_interpolate(-1, f, data);
 }
 
 VNA_SHELL_FUNCTION(cmd_cal)
@@ -2163,6 +3162,7 @@ void set_electrical_delay(int ch, float seconds)
 {
   if (current_props._electrical_delay[ch] == seconds) return;
   current_props._electrical_delay[ch] = seconds;
+  average_reset();
   request_to_redraw(REDRAW_MARKER);
 }
 
@@ -2177,6 +3177,7 @@ void set_s21_offset(float offset)
 {
   if (s21_offset != offset) {
     s21_offset = offset;
+    average_reset();
     request_to_redraw(REDRAW_MARKER);
   }
 }
@@ -2280,6 +3281,55 @@ usage:
   shell_printf("%f" VNA_SHELL_NEWLINE_STR, current_props._electrical_delay[ch] * (1.0f / 1e-12f)); // return in picoseconds
 }
 
+#ifdef __USE_PORT_EXTENSION__
+static int16_t portext_loss_value(float loss) {
+  loss*= 1.0f / PORTEXT_LOSS_UNIT;
+  if (loss >  INT16_MAX) loss =  INT16_MAX;
+  if (loss < -INT16_MAX) loss = -INT16_MAX;
+  return (int16_t)(loss < 0.0f ? loss - 0.5f : loss + 0.5f);
+}
+
+void set_port_extension(float delay, float loss0, float loss1, freq_t freq)
+{
+  portext_delay   = delay;
+  portext_loss[0] = portext_loss_value(loss0);
+  portext_loss[1] = portext_loss_value(loss1);
+  portext_freq    = freq;
+  average_reset();
+  request_to_redraw(REDRAW_MARKER | REDRAW_CAL_STATUS);
+}
+
+VNA_SHELL_FUNCTION(cmd_portext)
+{
+  static const char cmd_portext_list[] = "off|auto";
+  float loss0 = portext_loss[0] * PORTEXT_LOSS_UNIT;
+  float loss1 = portext_loss[1] * PORTEXT_LOSS_UNIT;
+  if (argc == 0) {
+    shell_printf("%f %f %f %u" VNA_SHELL_NEWLINE_STR, portext_delay * (1.0f / 1e-12f), loss0, loss1, portext_freq); // delay in picoseconds, loss in dB
+    return;
+  }
+  if (argc > 4) goto usage;
+  switch (get_str_index(argv[0], cmd_portext_list)) {
+    case 0: set_port_extension(0.0f, 0.0f, 0.0f, 0); return;
+#ifdef __USE_PORT_EXTENSION_AUTO__
+    case 1: port_extension_auto(); return;
+#endif
+    case -1: break;
+    default: goto usage;
+  }
+  if (argc >= 2) loss1 = loss0 = my_atof(argv[1]);
+  if (argc >= 3) loss1 = my_atof(argv[2]);
+  set_port_extension(my_atof(argv[0]) * 1e-12f, loss0, loss1, argc == 4 ? my_atoui(argv[3]) : portext_freq);
+  return;
+usage:
+  shell_printf("usage: portext {delay(ps)} [{loss(dB)} [{loss at freq(dB)} {freq(Hz)}]]|off"
+#ifdef __USE_PORT_EXTENSION_AUTO__
+               "|auto"
+#endif
+               VNA_SHELL_NEWLINE_STR);
+}
+#endif
+
 VNA_SHELL_FUNCTION(cmd_s21offset)
 {
   if (argc != 1) {
@@ -2384,19 +3434,58 @@ set_timedomain_func(uint32_t func) // accept TD_FUNC_LOWPASS_IMPULSE, TD_FUNC_LO
 }
 
 static inline void
-set_timedomain_window(uint32_t func) // accept TD_WINDOW_MINIMUM/TD_WINDOW_NORMAL/TD_WINDOW_MAXIMUM
+set_timedomain_window(uint32_t func) // accept TD_WINDOW_MINIMUM/TD_WINDOW_NORMAL/TD_WINDOW_MAXIMUM/TD_WINDOW_USER or TD_WINDOW_HANN/TD_WINDOW_BLACKMAN
 {
-  props_mode = (props_mode & ~TD_WINDOW) | func;
+  props_mode = (props_mode & ~(TD_WINDOW|TD_WINDOW_TYPE)) | func;
 }
 
+void
+set_timedomain_beta(int beta) // user Kaiser window beta
+{
+  if (beta < 0) beta = 0;
+  if (beta > TD_BETA_MAX) beta = TD_BETA_MAX;
+  td_beta = beta;
+}
+
+#ifdef __USE_FFT_SIZE_SELECT__
+void
+set_timedomain_fft_size(uint16_t size) // accept FFT_SIZE ... FFT_SIZE_MAX (rounded up to 2^n)
+{
+  uint16_t n = 0;
+  while ((FFT_SIZE << n) < size && (FFT_SIZE << n) < FFT_SIZE_MAX) n++;
+  props_mode = (props_mode & ~TD_FFT_SIZE) | (n << TD_FFT_SIZE_SHIFT);
+  request_to_redraw(REDRAW_FREQUENCY | REDRAW_MARKER);
+}
+#endif
+
+#ifdef __USE_TD_ZOOM__
+void
+set_timedomain_zoom(float start, float stop) // time window in seconds, start == stop disable zoom
+{
+  td_zoom_start = start;
+  td_zoom_stop  = stop;
+  request_to_redraw(REDRAW_FREQUENCY | REDRAW_MARKER);
+}
+#endif
+
+#ifdef __USE_TD_GATE__
+void
+set_timedomain_gate(float center, float span) // gate center and span in seconds
+{
+  td_gate_center = center;
+  td_gate_span   = span;
+  request_to_redraw(REDRAW_CAL_STATUS);
+}
+#endif
+
 VNA_SHELL_FUNCTION(cmd_transform)
 {
   int i;
   if (argc == 0) {
     goto usage;
   }
-  //                                         0   1       2    3        4       5      6       7
-  static const char cmd_transform_list[] = "on|off|impulse|step|bandpass|minimum|normal|maximum";
+  //                                         0   1       2    3        4       5      6       7    8    9    10      11   12   13
+  static const char cmd_transform_list[] = "on|off|impulse|step|bandpass|minimum|normal|maximum|zoom|gate|hann|blackman|beta|size";
   for (i = 0; i < argc; i++) {
     switch (get_str_index(argv[i], cmd_transform_list)) {
       case 0: set_domain_mode(DOMAIN_TIME); break;
@@ -2407,6 +3496,35 @@ VNA_SHELL_FUNCTION(cmd_transform)
       case 5: set_timedomain_window(TD_WINDOW_MINIMUM); break;
       case 6: set_timedomain_window(TD_WINDOW_NORMAL); break;
       case 7: set_timedomain_window(TD_WINDOW_MAXIMUM); break;
+#ifdef __USE_TD_ZOOM__
+      case 8: // zoom {start} {stop} in seconds, zoom 0 0 for disable
+        if (i + 2 >= argc) goto usage;
+        set_timedomain_zoom(my_atof(argv[i + 1]), my_atof(argv[i + 2]));
+        i+= 2;
+        break;
+#endif
+#ifdef __USE_TD_GATE__
+      case 9: // gate {center} {span} in seconds, or gate off
+        if (i + 1 < argc && get_str_index(argv[i + 1], "off") == 0) {props_mode&=~TD_GATE; request_to_redraw(REDRAW_CAL_STATUS); i++; break;}
+        if (i + 2 >= argc) goto usage;
+        set_timedomain_gate(my_atof(argv[i + 1]), my_atof(argv[i + 2]));
+        props_mode|= TD_GATE;
+        i+= 2;
+        break;
+#endif
+      case 10: set_timedomain_window(TD_WINDOW_HANN); break;
+      case 11: set_timedomain_window(TD_WINDOW_BLACKMAN); break;
+      case 12: // beta {value}, select Kaiser window with user beta
+        if (++i >= argc) goto usage;
+        set_timedomain_beta(my_atoi(argv[i]));
+        set_timedomain_window(TD_WINDOW_USER);
+        break;
+#ifdef __USE_FFT_SIZE_SELECT__
+      case 13: // size {value}, FFT size
+        if (++i >= argc) goto usage;
+        set_timedomain_fft_size(my_atoui(argv[i]));
+        break;
+#endif
       default:
         goto usage;
     }
@@ -2620,6 +3738,112 @@ VNA_SHELL_FUNCTION(cmd_si5351reg)
 }
 #endif
 
+#ifdef ENABLE_AUTOTUNE_COMMAND
+/*
+ * Generator ready and channel switch delays autotune (need connect thru or load)
+ * For every band step frequency and measure with decreasing delays, while result equal reference (measured with long delay)
+ */
+#define TUNE_REF_DELAY       3000                // Reference delay in us (all transients ended)
+#define TUNE_START_DELAY     30                  // Start test delay (in 10us)
+#define TUNE_REPEAT          3                   // Measure count on every delay
+#define TUNE_ERROR           2e-3f               // Max allowed relative error
+#define TUNE_MARGIN(d)       ((d) + (d)/4 + 1)   // Margin added to found delay
+
+static float tune_measure(uint8_t ch, uint32_t delay_us, void (*func)(float *), float v[2]) {
+  tlv320aic3204_select(ch);
+  DSP_START(US2ST(delay_us));
+  DSP_WAIT;
+  func(v);
+  return v[0] * v[0] + v[1] * v[1];
+}
+
+// Find minimum delay (in 10us) for generator step from prev to freq (if prev == 0 find delay for channel switch to ch)
+// Return 0 if start delay not enough (need use default) or on break
+static uint8_t tune_find_delay(freq_t freq, freq_t prev, uint8_t ch) {
+  float ref[2], v[2];
+  // Generator step check on reference level, channel switch on sample level
+  void (*func)(float *) = prev ? fetch_amplitude_ref : fetch_amplitude;
+  set_frequency(freq);
+  float level = tune_measure(ch, TUNE_REF_DELAY, func, ref);
+  uint8_t d, found = 0;
+  for (d = TUNE_START_DELAY; d > 0; d--) {
+    for (int i = 0; i < TUNE_REPEAT; i++) {
+      if (prev) {
+        set_frequency(prev);
+        chThdSleepMicroseconds(TUNE_REF_DELAY);
+        set_frequency(freq);
+      }
+      else
+        tune_measure(ch^1, TUNE_REF_DELAY, func, v);
+      tune_measure(ch, d * 10, func, v);
+      v[0]-= ref[0]; v[1]-= ref[1];
+      if (v[0] * v[0] + v[1] * v[1] > level * (TUNE_ERROR * TUNE_ERROR))
+        return found;
+      if (operation_requested) return 0;
+    }
+    found = d;
+  }
+  return found;
+}
+
+VNA_SHELL_FUNCTION(cmd_autotune)
+{
+  if (argc == 1 && get_str_index(argv[0], "reset") == 0) {
+    memset(config._band_delay, 0, sizeof(config._band_delay));
+    config._channel_delay = 0;
+    si5351_update_timings();
+    return;
+  }
+  if (argc != 0) {
+    shell_printf("usage: autotune [reset]" VNA_SHELL_NEWLINE_STR);
+    return;
+  }
+  uint8_t delay[SI5351_BANDS_MAX] = {0};
+  uint16_t tested = 0;                     // bands bitmask
+  freq_t f, step = FREQUENCY_MAX / 256;
+  uint16_t band;
+  // Low frequency bands
+  static const freq_t low_freq[] = {10000, 500000};
+  for (band = 0; band < ARRAY_COUNT(low_freq); band++) {
+    f = low_freq[band];
+    delay[si5351_get_band(f)] = tune_find_delay(f, f - f / 128, 1);
+    tested|= 1 << si5351_get_band(f);
+    if (operation_requested) goto abort;
+  }
+  // Measure on first step frequency in every band
+  for (f = step/2; f < FREQUENCY_MAX; f+= step) {
+    band = si5351_get_band(f);
+    if (band >= SI5351_BANDS_MAX || (tested & (1 << band))) continue;
+    delay[band] = tune_find_delay(f, f - f / 128, 1);
+    tested|= 1 << band;
+    if (operation_requested) goto abort;
+  }
+  // Channel switch (use middle frequency), if start delay not enough on any channel use default
+  uint8_t ch_d = tune_find_delay(FREQUENCY_THRESHOLD / 2, 0, 0);
+  uint8_t d = tune_find_delay(FREQUENCY_THRESHOLD / 2, 0, 1);
+  if (operation_requested) goto abort;
+  ch_d = (ch_d == 0 || d == 0) ? 0 : (d > ch_d ? d : ch_d);
+  // Store with margin (0 - use default)
+  for (band = 0; band < SI5351_BANDS_MAX; band++) {
+    config._band_delay[band] = delay[band] ? TUNE_MARGIN(delay[band]) : 0;
+    if (delay[band])
+      shell_printf("band %d: %d us" VNA_SHELL_NEWLINE_STR, band, config._band_delay[band] * 10);
+    else if (tested & (1 << band))
+      shell_printf("band %d: default" VNA_SHELL_NEWLINE_STR, band);
+  }
+  config._channel_delay = ch_d ? TUNE_MARGIN(ch_d) : 0;
+  if (ch_d)
+    shell_printf("channel: %d us" VNA_SHELL_NEWLINE_STR, config._channel_delay * 10);
+  else
+    shell_printf("channel: default" VNA_SHELL_NEWLINE_STR);
+  shell_printf("use saveconfig for store" VNA_SHELL_NEWLINE_STR);
+  si5351_update_timings();
+  return;
+abort:
+  shell_printf("autotune aborted" VNA_SHELL_NEWLINE_STR);
+}
+#endif
+
 #ifdef ENABLE_I2C_TIMINGS
 VNA_SHELL_FUNCTION(cmd_i2ctime)
 {
@@ -2631,6 +3855,16 @@ VNA_SHELL_FUNCTION(cmd_i2ctime)
 }
 #endif
 
+#ifdef __USE_I2C_STAT__
+VNA_SHELL_FUNCTION(cmd_i2cstat)
+{
+  (void)argc;
+  (void)argv;
+  shell_printf("sweep I2C wait: %u us, transfers: %u, bytes: %u" VNA_SHELL_NEWLINE_STR,
+               i2c_stat_time_us(i2c_sweep_stat.wait), i2c_sweep_stat.count, i2c_sweep_stat.bytes);
+}
+#endif
+
 #ifdef ENABLE_INFO_COMMAND
 VNA_SHELL_FUNCTION(cmd_info)
 {
@@ -2879,6 +4113,7 @@ VNA_SHELL_FUNCTION(cmd_sd_delete)
 }
 #endif
 
+
 #ifdef __SD_CARD_LOAD__
 VNA_SHELL_FUNCTION(cmd_msg)
 {
@@ -2929,6 +4164,12 @@ static const VNAShellCommand commands[] =
     {"offset"      , cmd_offset      , CMD_WAIT_MUTEX|CMD_RUN_IN_UI|CMD_RUN_IN_LOAD},
 #endif
     {"bandwidth"   , cmd_bandwidth   , CMD_RUN_IN_LOAD},
+#ifdef __USE_ADAPTIVE_IFBW__
+    {"adaptive"    , cmd_adaptive    , CMD_RUN_IN_LOAD},
+#endif
+#ifdef __USE_AUTO_IFBW__
+    {"autobw"      , cmd_autobw      , CMD_RUN_IN_LOAD},
+#endif
 #ifdef __USE_RTC__
     {"time"        , cmd_time        , CMD_RUN_IN_UI},
 #endif
@@ -2973,6 +4214,9 @@ static const VNAShellCommand commands[] =
     {"trace"       , cmd_trace       , CMD_RUN_IN_LOAD},
     {"marker"      , cmd_marker      , CMD_RUN_IN_LOAD},
     {"edelay"      , cmd_edelay      , CMD_RUN_IN_LOAD},
+#ifdef __USE_PORT_EXTENSION__
+    {"portext"     , cmd_portext     , CMD_RUN_IN_LOAD},
+#endif
     {"s21offset"   , cmd_s21offset   , CMD_RUN_IN_LOAD},
     {"capture"     , cmd_capture     , CMD_WAIT_MUTEX|CMD_BREAK_SWEEP|CMD_RUN_IN_UI},
 #ifdef __VNA_MEASURE_MODULE__
@@ -2989,6 +4233,9 @@ static const VNAShellCommand commands[] =
 #ifdef __USE_SMOOTH__
     {"smooth"      , cmd_smooth      , CMD_WAIT_MUTEX|CMD_BREAK_SWEEP|CMD_RUN_IN_UI|CMD_RUN_IN_LOAD},
 #endif
+#ifdef __USE_AVERAGE__
+    {"average"     , cmd_average     , CMD_WAIT_MUTEX|CMD_BREAK_SWEEP|CMD_RUN_IN_UI|CMD_RUN_IN_LOAD},
+#endif
 #ifdef ENABLE_CONFIG_COMMAND
     {"config"      , cmd_config      , CMD_WAIT_MUTEX|CMD_BREAK_SWEEP|CMD_RUN_IN_UI|CMD_RUN_IN_LOAD},
 #endif
@@ -3031,6 +4278,12 @@ static const VNAShellCommand commands[] =
 #ifdef ENABLE_I2C_TIMINGS
     {"i"           , cmd_i2ctime     , CMD_WAIT_MUTEX},
 #endif
+#ifdef __USE_I2C_STAT__
+    {"i2cstat"     , cmd_i2cstat     , 0},
+#endif
+#ifdef ENABLE_AUTOTUNE_COMMAND
+    {"autotune"    , cmd_autotune    , CMD_WAIT_MUTEX|CMD_BREAK_SWEEP},
+#endif
 #ifdef ENABLE_BAND_COMMAND
     {"b"           , cmd_band        , CMD_WAIT_MUTEX},
 #endif
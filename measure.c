@@ -788,5 +788,54 @@ static void prepare_s11_resonance(uint8_t type, uint8_t update_mask) {
                   STR_MEASURE_X + 3 * STR_MEASURE_WIDTH, STR_MEASURE_Y + (MEASURE_RESONANCE_COUNT + 1) * STR_MEASURE_HEIGHT);
 }
 #endif //__S11_RESONANCE_MEASURE__
+
+#ifdef __USE_PORT_EXTENSION_AUTO__
+//================================================================================
+// Port extension auto fit on S11 open/short trace (need phase step between points < 180 degree)
+// Fit made on corrected data, so result add to current port extension values:
+//   delay - linear regression of unwrapped phase vs f
+//   loss  - linear regression of loss vs sqrt(f)
+static float portext_phase_prev, portext_phase;
+static float portext_get_freq(uint16_t i) {
+  return getFrequency(i) * 1e-9f;
+}
+
+static float portext_get_sqrt_freq(uint16_t i) {
+  return vna_sqrtf(getFrequency(i) * 1e-9f);
+}
+
+// Regression call it sequentially for i = 0 .. N-1, so can unwrap phase (in turns) on the fly
+static float portext_get_phase(uint16_t i) {
+  float p = vna_atan2f(measured[0][i][1], measured[0][i][0]) * (1.0f / (2.0f * VNA_PI));
+  if (i == 0) portext_phase = p;
+  else {
+    float d = p - portext_phase_prev;
+    if      (d >  0.5f) d-= 1.0f;
+    else if (d < -0.5f) d+= 1.0f;
+    portext_phase+= d;
+  }
+  portext_phase_prev = p;
+  return portext_phase;
+}
+
+static float portext_get_loss(uint16_t i) {
+  return -0.5f * logmag(i, measured[0][i]);
+}
+
+void port_extension_auto(void) {
+  if (sweep_points < 2) return;
+  float r[2];
+  // S11 phase = -2 * delay * f (in turns)
+  linear_regression(sweep_points, portext_get_freq, portext_get_phase, r);
+  float delay = portext_delay - r[1] * (1e-9f / 2.0f);
+  // One way loss = a + b * sqrt(f)
+  linear_regression(sweep_points, portext_get_sqrt_freq, portext_get_loss, r);
+  float loss0 = portext_loss[0] * PORTEXT_LOSS_UNIT;
+  float loss1 = portext_loss[1] * PORTEXT_LOSS_UNIT;
+  freq_t f = portext_freq;
+  if (f == 0) {f = getFrequency(sweep_points - 1); loss1 = loss0;}
+  set_port_extension(delay, loss0 + r[0], loss1 + r[0] + r[1] * vna_sqrtf(f * 1e-9f), f);
+}
+#endif // __USE_PORT_EXTENSION_AUTO__
 #pragma GCC pop_options
 #endif // __VNA_MEASURE_MODULE__
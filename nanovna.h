@@ -70,22 +70,60 @@
 #define __VNA_USE_MATH_TABLES__
 // Use custom fast/compact approximation for some math functions in calculations (vna_ ...), use it carefully
 #define __USE_VNA_MATH__
-// Use cache for window function used by FFT (but need FFT_SIZE*sizeof(float) RAM)
-//#define USE_FFT_WINDOW_BUFFER
+// Enable time domain zoom (Chirp-Z transform for user set time window, on F303 by Bluestein FFT convolution, on F072 direct need sweep_points^2 complex mul per trace)
+#define __USE_TD_ZOOM__
+// Use 8k CCM RAM (only F303, DMA not have access to it): time domain work buffer, scan noise or sweep caches
+#if defined(NANOVNA_F303)
+#define __USE_CCM_BUFFER__
+#endif
+// Allow runtime select FFT size for time domain (FFT bigger then FFT_SIZE made by FFT_SIZE parts, need sweep points output buffer, use CCM buffer)
+#ifdef __USE_CCM_BUFFER__
+#define __USE_FFT_SIZE_SELECT__
+#endif
+// Enable time domain gating (transform to time domain, apply gate and transform back, gate edge cached in small table)
+#define __USE_TD_GATE__
 // Enable data smooth option
 #define __USE_SMOOTH__
+// Enable sweep to sweep averaging option (exponential and block modes, need 2*SWEEP_POINTS_MAX*2*sizeof(uint16_t) for half float average buffer, use CCM buffer)
+#ifdef __USE_CCM_BUFFER__
+#define __USE_AVERAGE__
+#endif
+// Enable adaptive IFBW option (stop point integration then measured value error less then user set limit)
+#define __USE_ADAPTIVE_IFBW__
 // Enable optional change digit separator for locales (dot or comma, need for correct work some external software)
 #define __DIGIT_SEPARATOR__
+// Enable auto IFBW option (select point bandwidth by signal level on previous sweep)
+#define __USE_AUTO_IFBW__
+// Measure per point noise (standard error of measured value), allow output it by scan command (need 2*SWEEP_POINTS_MAX*sizeof(float) RAM, use CCM buffer)
+#ifdef __USE_CCM_BUFFER__
+#define __USE_SWEEP_NOISE__
+#endif
+// Use cache for calibration interpolation index and k of sweep points (need 4*SWEEP_POINTS_MAX bytes RAM, use CCM buffer)
+#ifdef __USE_CCM_BUFFER__
+#define __USE_CAL_INTERP_CACHE__
+#endif
+// Use cubic (Catmull-Rom spline) calibration interpolation inside harmonic bands (if disabled use linear)
+#define __USE_CAL_CUBIC_INTERP__
+// Apply electrical delay by phasor rotation on constant phase step (need linear frequency list)
+#define __USE_EDELAY_ROTATOR__
+// Enable port extension (remove delay and loss of cable/fixture between calibration plane and DUT)
+#define __USE_PORT_EXTENSION__
 // Use table for frequency list (if disabled use real time calc)
 //#define __USE_FREQ_TABLE__
+// Use cache for si5351 registers of sweep frequencies (use CCM buffer)
+#ifdef __USE_CCM_BUFFER__
+#define __USE_FREQ_PLAN_CACHE__
+#endif
 // Enable DSP instruction (support only by Cortex M4 and higher)
 #ifdef ARM_MATH_CM4
 #define __USE_DSP__
 #endif
 // Add measure module option (allow made some measure calculations on data)
 #define __VNA_MEASURE_MODULE__
-// Add Z normalization feature
-//#define __VNA_Z_RENORMALIZATION__
+// Add Z normalization feature (complex port impedance)
+#ifdef NANOVNA_F303
+#define __VNA_Z_RENORMALIZATION__
+#endif
 
 /*
  * Submodules defines
@@ -112,6 +150,10 @@
 #define __S11_CABLE_MEASURE__
 // Enable S11 resonance search option
 #define __S11_RESONANCE_MEASURE__
+// Enable port extension auto fit on open/short S11 trace
+#ifdef __USE_PORT_EXTENSION__
+#define __USE_PORT_EXTENSION_AUTO__
+#endif
 #endif
 
 /*
@@ -180,6 +222,12 @@
 #define XTALFREQ                 26000000U
 // Define i2c bus speed, add predefined for 400k, 600k, 900k
 #define STM32_I2C_SPEED          900
+// Use DMA for I2C transfers, CPU not wait transfer end (only F303 have free DMA channel for I2C)
+#if defined(NANOVNA_F303)
+#define __USE_I2C_DMA__
+#endif
+// Collect I2C bus CPU wait time statistic (i2cstat command)
+#define __USE_I2C_STAT__
 // Define default src impedance for xtal calculations
 #define MEASURE_DEFAULT_R        50.0f
 
@@ -306,6 +354,50 @@ extern float measured[2][SWEEP_POINTS_MAX][2];
 #elif SWEEP_POINTS_MAX <= 512
 #define FFT_SIZE   512
 #endif
+// Max runtime selected FFT size (FFT_SIZE << n)
+#ifdef __USE_FFT_SIZE_SELECT__
+#define FFT_SIZE_MAX 2048
+#else
+#define FFT_SIZE_MAX FFT_SIZE
+#endif
+
+#ifdef __USE_CCM_BUFFER__
+// CCM RAM buffer, shared area at start used for one of:
+//  - time domain work buffer (chirp-Z or FFT size bigger then FFT_SIZE, FFT_SIZE complex values)
+//  - scan noise (valid only after scan with noise measure)
+//  - sweep caches (calibration interpolation, si5351 plan), not used then shared area need for work or noise
+// other areas placed at end (sweep caches can use it if not used)
+#define CCM_BUFFER_SIZE        (8*1024)
+#define CCM_SHARED_SIZE        (2 * 4 * FFT_SIZE)
+extern float ccm_buffer[CCM_BUFFER_SIZE / sizeof(float)];
+#define ccm_work               ((float (*)[2])ccm_buffer)
+#ifdef __USE_SWEEP_NOISE__
+// Read only access to last noise scan result (stored by sweep only after ccm_buffer_work() call)
+#define measured_noise         ((const float (*)[SWEEP_POINTS_MAX])ccm_buffer)
+#endif
+#if 2 * SWEEP_POINTS_MAX * 4 > CCM_SHARED_SIZE
+#error "Need increase CCM shared area"
+#endif
+// Sweep caches layout
+#ifdef __USE_CAL_INTERP_CACHE__
+#define CAL_INTERP_CACHE_SIZE  (SWEEP_POINTS_MAX * 4)
+#else
+#define CAL_INTERP_CACHE_SIZE  0
+#endif
+// Time domain window cache placed at end, used only in time domain mode
+#define CCM_TD_WINDOW_OFFSET   (CCM_BUFFER_SIZE - SWEEP_POINTS_MAX * 2)
+#define ccm_td_window          ((uint16_t *)((uint8_t *)ccm_buffer + CCM_TD_WINDOW_OFFSET))
+// Average accumulator (half float) placed before window cache, used only if averaging enabled
+#define CCM_AVERAGE_OFFSET     (CCM_TD_WINDOW_OFFSET - SWEEP_POINTS_MAX * 2 * 2 * 2)
+#define ccm_average            ((uint16_t (*)[SWEEP_POINTS_MAX][2])((uint8_t *)ccm_buffer + CCM_AVERAGE_OFFSET))
+#if CCM_SHARED_SIZE > CCM_AVERAGE_OFFSET
+#error "CCM buffer areas overlap"
+#endif
+// Sweep caches can use all CCM buffer up to first used area after shared area
+uint16_t ccm_cache_size(void);
+#define PLAN_CACHE_POOL        (((uint8_t *)ccm_buffer) + CAL_INTERP_CACHE_SIZE)
+#define PLAN_CACHE_POOL_SIZE   (ccm_cache_size() - CAL_INTERP_CACHE_SIZE)
+#endif
 
 void cal_collect(uint16_t type);
 void cal_done(void);
@@ -331,6 +423,14 @@ void set_power(uint8_t value);
 
 void    set_smooth_factor(uint8_t factor);
 uint8_t get_smooth_factor(void);
+void    set_smooth_median(bool median);
+bool    get_smooth_median(void);
+
+#define AVERAGE_EXP     0
+#define AVERAGE_BLOCK   1
+void    set_average(uint8_t count, uint8_t mode);
+uint8_t get_average_count(void);
+uint8_t get_average_mode(void);
 
 int32_t  my_atoi(const char *p);
 uint32_t my_atoui(const char *p);
@@ -380,7 +480,7 @@ void send_region(remote_region_t *rd, uint8_t * buf, uint16_t size);
 #define SWEEP_UI_MODE 0x80
 
 extern  uint8_t sweep_mode;
-extern const char *info_about[];
+extern const char * const info_about[];
 
 /*
  * Measure timings for si5351 generator, after ready
@@ -408,6 +508,14 @@ extern const char *info_about[];
 #define DELAY_RESET_PLL_BEFORE            0    // 5    0 (0 for disabled)
 #define DELAY_RESET_PLL_AFTER          4000    // 6 4000 (0 for disabled)
 #endif
+// Poll si5351 PLL lock status on band change, fixed delays DELAY_RESET_PLL_AFTER and DELAY_BANDCHANGE used only as timeout
+#define __USE_SI5351_LOCK_WAIT__
+// After PLL lock wait stable signal level, max wait time in us (checked on every DSP buffer)
+#define DELAY_BAND_SETTLE_MAX          2000
+// Max bands count in si5351 band strategy tables (used for store autotuned delays)
+#define SI5351_BANDS_MAX                 16
+// Channel switch delay (use autotuned value from config if set)
+#define DELAY_CHANNEL_SWITCH     (config._channel_delay ? (int)US2ST(config._channel_delay * 10) : (int)DELAY_CHANNEL_CHANGE)
 
 /*
  * dsp.c
@@ -466,7 +574,11 @@ extern const char *info_about[];
 typedef int16_t  audio_sample_t;
 void dsp_process(audio_sample_t *src, size_t len);
 void reset_dsp_accumerator(void);
+float get_ref_level(void);
 void calculate_gamma(float *gamma);
+void dsp_stat_update(void);
+bool dsp_stat_converged(float limit);
+float dsp_stat_error(void);
 void fetch_amplitude(float *gamma);
 void fetch_amplitude_ref(float *gamma);
 void generate_DSP_Table(int offset);
@@ -903,6 +1015,7 @@ enum {LM_MARKER, LM_SEARCH, LM_FREQ_0, LM_FREQ_1, LM_EDELAY};
 #define TD_WINDOW_NORMAL        (0b00<<3)
 #define TD_WINDOW_MINIMUM       (0b01<<3)
 #define TD_WINDOW_MAXIMUM       (0b10<<3)
+#define TD_WINDOW_USER          (0b11<<3) // Kaiser window with user beta
 // Sweep mode
 #define TD_START_STOP           (0<<0)
 #define TD_CENTER_SPAN          (1<<6)
@@ -912,6 +1025,18 @@ enum {LM_MARKER, LM_SEARCH, LM_FREQ_0, LM_FREQ_1, LM_EDELAY};
 #define TD_MARKER_DELTA         (1<<8)
 // Marker delta
 //#define TD_MARKER_LOCK          (1<<9) // reserved
+// Time domain gate (applied in frequency domain mode)
+#define TD_GATE                 (1<<10)
+// Time domain window type (TD_WINDOW size used only for Kaiser)
+#define TD_WINDOW_TYPE          (0b11<<11)
+#define TD_WINDOW_KAISER        (0b00<<11)
+#define TD_WINDOW_HANN          (0b01<<11)
+#define TD_WINDOW_BLACKMAN      (0b10<<11) // 4 term Blackman-Harris
+// Time domain FFT size = FFT_SIZE << n (up to FFT_SIZE_MAX)
+#define TD_FFT_SIZE             (0b11<<13)
+#define TD_FFT_SIZE_SHIFT       13
+// Max user Kaiser window beta (limited by bessel_I0_ext precision)
+#define TD_BETA_MAX             13
 
 //
 // config.vna_mode flags (16 bit field)
@@ -1008,7 +1133,10 @@ typedef struct config {
   uint32_t _xtal_freq;
   float    _measure_r;
   uint8_t  _band_mode;
-  uint8_t  _reserved[3];
+  uint8_t  _channel_delay;                  // autotuned channel switch delay (in 10us, 0 - use default)
+  uint8_t  _adaptive_ifbw;                  // adaptive IFBW relative error limit (in -dB, 0 - disabled)
+  uint8_t  _auto_ifbw;                      // auto IFBW signal level for full bandwidth use (in -dB, 0 - disabled)
+  uint8_t  _band_delay[SI5351_BANDS_MAX];   // autotuned generator ready delay for bands (in 10us, 0 - use default)
   uint32_t checksum;
 } config_t;
 
@@ -1031,14 +1159,19 @@ typedef struct properties {
   uint16_t _cal_status;          // calibration data collected flags
   trace_t  _trace[TRACES_MAX];
   marker_t _markers[MARKERS_MAX];
-  uint8_t  _reserved;
+  uint8_t  _td_beta;             // user Kaiser window beta for time domain
   uint8_t  _velocity_factor;     // 0 .. 100 %
   float    _electrical_delay[2]; // delays for S11 and S21 traces in seconds
   float    _var_delay;           // electrical delay step by leveler
   float    _s21_offset;          // additional external attenuator for S21 measures
-  float    _portz;               // Used for port-z renormalization
+  float    _portz;               // Used for port-z renormalization (real part)
+  float    _portz_x;             // Used for port-z renormalization (imaginary part)
   float    _cal_load_r;          // Used as calibration standard LOAD R value (calculated in renormalization procedure)
-  uint32_t _reserved1[7];
+  float    _td_zoom[2];          // time domain zoom window start/stop in seconds (equal values - zoom disabled)
+  float    _td_gate[2];          // time domain gate center/span in seconds
+  float    _portext_delay;       // port extension delay in seconds (one way)
+  int16_t  _portext_loss[2];     // port extension loss at DC and at _portext_freq in 0.001 dB (one way)
+  freq_t   _portext_freq;        // port extension loss reference frequency (0 - use only DC loss)
   float    _cal_data[CAL_TYPE_COUNT][SWEEP_POINTS_MAX][2]; // Put at the end for faster access to others data from struct
   uint32_t checksum;
 } properties_t;
@@ -1061,6 +1194,22 @@ void shell_reset_console(void);
 void  set_electrical_delay(int ch, float seconds);
 float get_electrical_delay(void);
 void set_s21_offset(float offset);
+void set_timedomain_beta(int beta);
+#ifdef __USE_FFT_SIZE_SELECT__
+void set_timedomain_fft_size(uint16_t size);
+#endif
+#ifdef __USE_TD_ZOOM__
+void set_timedomain_zoom(float start, float stop);
+#endif
+#ifdef __USE_TD_GATE__
+void set_timedomain_gate(float center, float span);
+#endif
+#ifdef __USE_PORT_EXTENSION__
+void set_port_extension(float delay, float loss0, float loss1, freq_t freq);
+#endif
+#ifdef __USE_PORT_EXTENSION_AUTO__
+void port_extension_auto(void);
+#endif
 float groupdelay_from_array(int i, const float *v);
 
 void plot_init(void);
@@ -1320,8 +1469,8 @@ void testLog(void);        // debug log
 /*
  * flash.c
  */
-#define CONFIG_MAGIC      0x434f4e56 // Config magic value (allow reset on new config version)
-#define PROPERTIES_MAGIC  0x434f4e54 // Properties magic value (allow reset on new properties version)
+#define CONFIG_MAGIC      0x434f4e57 // Config magic value (allow reset on new config version)
+#define PROPERTIES_MAGIC  0x434f4e55 // Properties magic value (allow reset on new properties version)
 
 #define NO_SAVE_SLOT      ((uint16_t)(-1))
 extern uint16_t lastsaveid;
@@ -1339,6 +1488,11 @@ extern uint16_t lastsaveid;
 #define electrical_delayS11 current_props._electrical_delay[0]
 #define electrical_delayS21 current_props._electrical_delay[1]
 #define s21_offset          current_props._s21_offset
+#define portext_delay       current_props._portext_delay
+#define portext_loss        current_props._portext_loss
+#define portext_freq        current_props._portext_freq
+#define PORTEXT_LOSS_UNIT   1e-3f
+#define portext_enabled()  (portext_delay != 0.0f || portext_loss[0] || portext_loss[1])
 #define velocity_factor     current_props._velocity_factor
 #define trace               current_props._trace
 #define current_trace       current_props._current_trace
@@ -1354,6 +1508,23 @@ extern uint16_t lastsaveid;
 #define props_mode          current_props._mode
 #define domain_window      (props_mode&TD_WINDOW)
 #define domain_func        (props_mode&TD_FUNC)
+#define td_beta             current_props._td_beta
+#ifdef __USE_FFT_SIZE_SELECT__
+#define td_fft_size()      (FFT_SIZE << ((props_mode & TD_FFT_SIZE) >> TD_FFT_SIZE_SHIFT))
+#else
+#define td_fft_size()       FFT_SIZE
+#endif
+#ifdef __USE_TD_ZOOM__
+#define td_zoom_start       current_props._td_zoom[0]
+#define td_zoom_stop        current_props._td_zoom[1]
+#define TD_ZOOM_ENABLED()  (td_zoom_start != td_zoom_stop)
+#else
+#define TD_ZOOM_ENABLED()   false
+#endif
+#ifdef __USE_TD_GATE__
+#define td_gate_center      current_props._td_gate[0]
+#define td_gate_span        current_props._td_gate[1]
+#endif
 
 #define FREQ_STARTSTOP()       {props_mode&=~TD_CENTER_SPAN;}
 #define FREQ_CENTERSPAN()      {props_mode|= TD_CENTER_SPAN;}
@@ -50,10 +50,18 @@ static map_t markmap[MAX_MARKMAP_Y];
 // Trace data cache, for faster redraw cells
 #define TRACE_INDEX_COUNT (TRACES_MAX+STORED_TRACES)
 
+// If plot HEIGHT < 256 y fit in byte, use packed 3 byte index (save RAM on F072)
+#if HEIGHT < 256
+typedef struct __attribute__((packed)) {
+  uint16_t x;
+  uint8_t  y;
+} index_t;
+#else
 typedef struct {
   uint16_t x;
   uint16_t y;
 } index_t;
+#endif
 static index_t trace_index[TRACE_INDEX_COUNT][SWEEP_POINTS_MAX];
 
 #if 1
@@ -434,10 +442,13 @@ static void invalidate_rect_func(int x0, int y0, int x1, int y1) {
 // This functions used for plot traces, and markers data output
 // Also can used in measure calculations
 //**************************************************************************************
+// Complex port impedance Zr = R + jX use power waves: S = (Z - Zr*) / (Z + Zr), so Z = R * (1 + S) / (1 - S) - jX
 #ifdef __VNA_Z_RENORMALIZATION__
 #define PORT_Z current_props._portz
+#define PORT_X current_props._portz_x
 #else
 #define PORT_Z 50.0f
+#define PORT_X 0.0f
 #endif
 // Help functions
 static float get_l(float re, float im) {return (re*re + im*im);}
@@ -534,17 +545,17 @@ static float resistance(int i, const float *v) {
 
 static float reactance(int i, const float *v) {
   (void) i;
-  return get_s11_x(1.0f - v[0], -v[1], PORT_Z);
+  return get_s11_x(1.0f - v[0], -v[1], PORT_Z) - PORT_X;
 }
 
 static float mod_z(int i, const float *v) {
-  (void) i;
+  if (PORT_X != 0.0f) return vna_sqrtf(get_l(resistance(i, v), reactance(i, v)));
   const float z0 = PORT_Z;
   return z0 * vna_sqrtf(get_l(1.0f + v[0], v[1]) / get_l(1.0f - v[0], v[1])); // always >= 0
 }
 
 static float phase_z(int i, const float *v) {
-  (void) i;
+  if (PORT_X != 0.0f) return vna_atan2f_deg(reactance(i, v), resistance(i, v));
   const float r = 1.0f - get_l(v[0], v[1]);
   const float x = 2.0f * v[1];
   return vna_atan2f_deg(x, r);
@@ -573,7 +584,7 @@ static float series_l(int i, const float *v) {
 // Q = 2 * im / (1 - re * re - im * im)
 //**************************************************************************************
 static float qualityfactor(int i, const float *v) {
-  (void) i;
+  if (PORT_X != 0.0f) return vna_fabsf(reactance(i, v) / resistance(i, v));
   const float r = 1.0f - get_l(v[0], v[1]);
   const float x = 2.0f * v[1];
   return vna_fabsf(x / r);
@@ -592,12 +603,12 @@ static float qualityfactor(int i, const float *v) {
 // |Y| = 1 / |Z|
 //**************************************************************************************
 static float conductance(int i, const float *v) {
-  (void) i;
+  if (PORT_X != 0.0f) {float r = resistance(i, v); return r / get_l(r, reactance(i, v));}
   return get_s11_r(1.0f + v[0], v[1], 1.0f / PORT_Z);
 }
 
 static float susceptance(int i, const float *v) {
-  (void) i;
+  if (PORT_X != 0.0f) {float x = reactance(i, v); return -x / get_l(resistance(i, v), x);}
   return get_s11_x(1.0f + v[0], v[1], 1.0f / PORT_Z);
 }
 
@@ -830,8 +841,12 @@ static int trace_print_info(int xpos, int ypos, int t) {
 }
 
 static float time_of_index(int idx) {
+#ifdef __USE_TD_ZOOM__
+  if (TD_ZOOM_ENABLED())
+    return td_zoom_start + idx * (td_zoom_stop - td_zoom_start) / (sweep_points - 1);
+#endif
   freq_t span = get_sweep_frequency(ST_SPAN);
-  return (idx * (sweep_points-1)) / ((float)FFT_SIZE * span);
+  return (idx * (sweep_points-1)) / ((float)td_fft_size() * span);
 }
 
 static float distance_of_index(int idx) {
@@ -929,7 +944,7 @@ static int marker_area_max(void) {
   if (get_electrical_delay() != 0.0f) extra+= 2;
   if (s21_offset != 0.0f) extra+= 2;
 #ifdef __VNA_Z_RENORMALIZATION__
-  if (current_props._portz != 50.0f) extra+= 2;
+  if (current_props._portz != cal_load_r || PORT_X != 0.0f) extra+= 2;
 #endif
   if (extra < 2) extra = 2;
   cnt = (cnt + extra + 1)>>1;
@@ -1358,8 +1373,8 @@ static void cell_draw_marker_info(int x0, int y0) {
     ypos+= FONT_STR_HEIGHT;
   }
 #ifdef __VNA_Z_RENORMALIZATION__
-  if (current_props._portz != 50.0f) {
-    cell_printf(xpos, ypos, "PORT-Z: 50 " S_RARROW " %F" S_OHM, current_props._portz);
+  if (current_props._portz != cal_load_r || PORT_X != 0.0f) {
+    cell_printf(xpos, ypos, "PORT-Z: %F " S_RARROW " %F%+jF" S_OHM, cal_load_r, current_props._portz, PORT_X);
     ypos+= FONT_STR_HEIGHT;
   }
 #endif
@@ -1622,6 +1637,11 @@ static void draw_frequencies(void) {
       lcd_printf(FREQUENCIES_XPOS2, FREQUENCIES_YPOS, "%c%s %15q" S_Hz, lm1,  "SPAN", get_sweep_frequency(ST_SPAN));
     }
   } else {
+#ifdef __USE_TD_ZOOM__
+    if (TD_ZOOM_ENABLED())
+      lcd_printf(FREQUENCIES_XPOS1, FREQUENCIES_YPOS, "START %F" S_SECOND "    VF = %d%%", time_of_index(0), velocity_factor);
+    else
+#endif
     lcd_printf(FREQUENCIES_XPOS1, FREQUENCIES_YPOS, "START 0" S_SECOND "    VF = %d%%", velocity_factor);
     lcd_printf(FREQUENCIES_XPOS2, FREQUENCIES_YPOS, "STOP %F" S_SECOND " (%F" S_METRE ")", time_of_index(sweep_points-1), distance_of_index(sweep_points-1));
   }
@@ -1678,6 +1698,29 @@ static void draw_cal_status(void) {
     lcd_set_foreground(LCD_FG_COLOR);
     lcd_printf(x, y+=sFONT_STR_HEIGHT, "s%d", smooth);
   }
+  if (get_smooth_median()){
+    lcd_set_foreground(LCD_FG_COLOR);
+    lcd_printf(x, y+=sFONT_STR_HEIGHT, "med");
+  }
+#endif
+#ifdef __USE_AVERAGE__
+  uint8_t average = get_average_count();
+  if (average > 1){
+    lcd_set_foreground(LCD_FG_COLOR);
+    lcd_printf(x, y+=sFONT_STR_HEIGHT, "a%d", average);
+  }
+#endif
+#ifdef __USE_PORT_EXTENSION__
+  if (portext_enabled()){
+    lcd_set_foreground(LCD_FG_COLOR);
+    lcd_printf(x, y+=sFONT_STR_HEIGHT, "pext");
+  }
+#endif
+#ifdef __USE_TD_GATE__
+  if ((props_mode & (DOMAIN_MODE|TD_GATE)) == (DOMAIN_FREQ|TD_GATE)){
+    lcd_set_foreground(LCD_FG_COLOR);
+    lcd_printf(x, y+=sFONT_STR_HEIGHT, "gate");
+  }
 #endif
   lcd_set_font(FONT_NORMAL);
 }
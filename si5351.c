@@ -21,6 +21,7 @@
 #include "hal.h"
 #include "nanovna.h"
 #include "si5351.h"
+#include <string.h>
 
 // audio codec frequency clock
 #define CLK2_FREQUENCY AUDIO_CLOCK_REF
@@ -31,15 +32,66 @@
 // I2C address on bus (only 0x60 for Si5351A in 10-Pin MSOP)
 #define SI5351_I2C_ADDR     0x60
 
-static uint8_t  current_band   = 0;
-static uint8_t  current_power  = 0;
-static uint32_t current_freq   = 0;
-// Use cache for this reg, not update if not change
-static uint8_t  clk_cache[3] = {0, 0, 0};
+// Generator state
+typedef struct {
+  uint32_t freq;
+  uint8_t  band;
+  uint8_t  power;
+  uint8_t  clk[3];     // Use cache for this reg, not update if not change
+} si5351_state_t;
+
+// Prepared register image for frequency set (allow calculate it while DSP process previous point)
+typedef struct {
+  si5351_state_t dst;  // generator state after apply
+  uint8_t  from_band;  // band used as previous on calculate
+  uint8_t  len;        // used buffer size
+  uint16_t delay;      // generator ready delay after apply
+  uint8_t  buf[];      // format same as si5351_configs: len, register addr, data, ...
+} si5351_plan_t;
+
+// Max register image size (worst case on band change 59 bytes)
+#define SI5351_PLAN_SIZE   64
+
+static si5351_state_t gen;
+// Prepared plan and generator state it calculated for
+static si5351_state_t plan_src;
+static union {
+  si5351_plan_t p;
+  uint8_t data[sizeof(si5351_plan_t) + SI5351_PLAN_SIZE];
+} plan_data;
+static si5351_plan_t * const plan = &plan_data.p;
+// Plan used for registers calculation
+static si5351_plan_t *wr_plan;
+
+#ifdef __USE_FREQ_PLAN_CACHE__
+// Sweep frequencies plan cache, calculated once after frequencies change, not need made calculation on sweep
+// Cache pool placed in CCM buffer (shared with time domain and noise, on use it cache reset), can hold not all points,
+// others calculate as usual
+// Point format: band, blocks size, register blocks (start register, data), block data size defined by start register
+// Multisynth and PLL blocks store only data from first changed (from previous point) register up to end
+static struct {
+  bool           valid;
+  uint8_t        power;                     // drive strength used on build
+  uint16_t       points;                    // cached points count
+  uint16_t       count;                     // sweep points count, frequency range and harmonic threshold used on build
+  uint32_t       start, stop, threshold;
+  uint16_t       next, rd;                  // next point index and it pool offset (sweep read cache sequentially)
+  si5351_state_t src;                       // generator state for first point (state after last point)
+  si5351_state_t last;                      // generator state after last loaded point
+} plan_cache;
+#define plan_cache_pool   PLAN_CACHE_POOL
+
+void si5351_plan_cache_reset(void) {
+  plan_cache.valid = false;
+}
+#else
+#define si5351_plan_cache_reset()
+#endif
 
 static void si5351_reset_cache(void){
-  current_band = 0;
-  current_freq = 0;
+  gen.band = 0;
+  gen.freq = 0;
+  plan->dst.freq = 0;
 }
 
 #ifdef ENABLE_SI5351_TIMINGS
@@ -53,7 +105,7 @@ uint16_t timings[8]={
   DELAY_RESET_PLL_BEFORE,  // 5
   DELAY_RESET_PLL_AFTER,   // 6
 };
-inline void si5351_set_timing(int i, int v) {timings[i]=US2ST(v);}
+inline void si5351_set_timing(int i, int v) {timings[i]=US2ST(v); si5351_plan_cache_reset();}
 #undef DELAY_BAND_1_2
 #undef DELAY_BAND_3_4
 #undef DELAY_BANDCHANGE
@@ -72,43 +124,53 @@ inline void si5351_set_timing(int i, int v) {timings[i]=US2ST(v);}
 #endif
 
 uint32_t si5351_get_frequency(void) {
-  return current_freq;
+  return gen.freq;
 }
 
 #ifdef USE_VARIABLE_OFFSET
 void si5351_set_frequency_offset(int32_t offset) {
   si5351_reset_cache();
+  si5351_plan_cache_reset();
   generate_DSP_Table(offset);
   IF_OFFSET = offset;
 }
 #endif
 
 void si5351_set_power(uint8_t drive_strength) {
-  if (drive_strength == current_power) return;
-  si5351_set_frequency(current_freq, drive_strength);
+  if (drive_strength == gen.power) return;
+  si5351_set_frequency(gen.freq, drive_strength);
 }
 
 void si5351_bulk_write(const uint8_t *buf, int len) {
   i2c_transfer(SI5351_I2C_ADDR, buf, len);
 }
 
-#if 0
+#ifdef __USE_SI5351_LOCK_WAIT__
 bool si5351_bulk_read(uint8_t reg, uint8_t* buf, int len) {
   return i2c_receive(SI5351_I2C_ADDR, &reg, 1, buf, len);
 }
-#endif
 
-#if 0
-static void si5351_wait_pll_lock(void) {
-  uint8_t status;
-  int count = 100;
-  do{
-    status=0xFF;
-    si5351_bulk_read(0, &status, 1);
-    if ((status & 0x60) == 0) // PLLA and PLLB locked
-      return;
-  }while (--count);
+// Wait PLLA and PLLB lock, return false on timeout (timeout in system ticks)
+static bool si5351_wait_pll_lock(systime_t timeout) {
+  systime_t start = chVTGetSystemTimeX();
+  do {
+    uint8_t status = 0xFF;
+    if (si5351_bulk_read(SI5351_REG_0_DEVICE_STATUS, &status, 1) &&
+       (status & (SI5351_STATUS_SYS_INIT|SI5351_STATUS_LOL_A|SI5351_STATUS_LOL_B)) == 0)
+      return true;
+  } while (chVTTimeElapsedSinceX(start) < timeout);
+  return false;
 }
+
+// Set on band change if PLL lock detected, sweep need check signal stability before measure
+static bool pll_relocked = false;
+bool si5351_pll_relocked(void) {
+  bool r = pll_relocked;
+  pll_relocked = false;
+  return r;
+}
+#else
+bool si5351_pll_relocked(void) {return false;}
 #endif
 
 static inline void si5351_write(uint8_t reg, uint8_t dat) {
@@ -185,6 +247,15 @@ void si5351_set_tcxo(uint32_t xtal) {
       xtal > XTALFREQ + 2000000) xtal = XTALFREQ;
   config._xtal_freq = xtal;
   si5351_reset_cache();
+  si5351_plan_cache_reset();
+}
+
+// Allocate registers block in prepared image
+static uint8_t *si5351_plan_block(uint8_t len) {
+  uint8_t *p = &wr_plan->buf[wr_plan->len];
+  *p = len;
+  wr_plan->len+= len + 1;
+  return p + 1;
 }
 
 static void si5351_setupPLL(uint8_t   pllSource,  // SI5351_REG_PLL_A or SI5351_REG_PLL_B
@@ -204,7 +275,7 @@ static void si5351_setupPLL(uint8_t   pllSource,  // SI5351_REG_PLL_A or SI5351_
   uint32_t P2 = num;
   uint32_t P3 = denom;
   // Pll MSN(A|B) registers Datasheet
-  uint8_t reg[9];
+  uint8_t *reg = si5351_plan_block(9);
   reg[0] = pllSource;                                       // SI5351_REG_PLL_A or SI5351_REG_PLL_B
   reg[1] = (P3 & 0x0FF00) >> 8;                             // MSN_P3[15: 8]
   reg[2] = (P3 & 0x000FF);                                  // MSN_P3[ 7: 0]
@@ -214,7 +285,6 @@ static void si5351_setupPLL(uint8_t   pllSource,  // SI5351_REG_PLL_A or SI5351_
   reg[6] = ((P3 & 0xF0000) >> 12) | ((P2 & 0xF0000) >> 16); // MSN_P3[19:16] | MSN_P2[19:16]
   reg[7] = (P2 & 0x0FF00) >> 8;                             // MSN_P2[15: 8]
   reg[8] = (P2 & 0x000FF);                                  // MSN_P2[ 7: 0]
-  si5351_bulk_write(reg, 9);
 }
 
 static void
@@ -240,7 +310,7 @@ si5351_setupMultisynth(uint32_t  channel,
   if (P1 == 0)
     rdiv|= SI5351_DIVBY4;
   // Set the MSx config registers
-  uint8_t reg[9];
+  uint8_t *reg = si5351_plan_block(9);
   reg[0] = msreg_base[channel];                       // SI5351_REG_42_MULTISYNTH0, SI5351_REG_50_MULTISYNTH1, SI5351_REG_58_MULTISYNTH2
   reg[1] = (P3 & 0x0FF00)>>8;                         // MSx_P3[15: 8]
   reg[2] = (P3 & 0x000FF);                            // MSx_P3[ 7: 0]
@@ -250,15 +320,16 @@ si5351_setupMultisynth(uint32_t  channel,
   reg[6] = ((P3 & 0xF0000)>>12)|((P2 & 0xF0000)>>16); // MSx_P3[19:16] | MSx_P2[19:16]
   reg[7] = (P2 & 0x0FF00)>>8;                         // MSx_P2[15: 8]
   reg[8] = (P2 & 0x000FF);                            // MSx_P2[ 7: 0]
-  si5351_bulk_write(reg, 9);
 
   // Configure the clk control and enable the output
   chctrl|= SI5351_CLK_INPUT_MULTISYNTH_N;
   if (num == 0)
     chctrl|= SI5351_CLK_INTEGER_MODE;
-  if (clk_cache[channel] != chctrl) {
-    si5351_write(SI5351_REG_16_CLK0_CONTROL + channel, chctrl);
-    clk_cache[channel] = chctrl;
+  if (wr_plan->dst.clk[channel] != chctrl) {
+    reg = si5351_plan_block(2);
+    reg[0] = SI5351_REG_16_CLK0_CONTROL + channel;
+    reg[1] = chctrl;
+    wr_plan->dst.clk[channel] = chctrl;
   }
 }
 
@@ -437,7 +508,12 @@ void si5351_set_band_mode(uint16_t t) {
     band_strategy_33H_SI5351, band_strategy_36H_MS5351, band_strategy_SWC5351
 #endif
   };
+  // Autotuned band delays valid only for band plan used on tune, reset to defaults
+  if (band_s && band_s != bs[t])
+    memset(config._band_delay, 0, sizeof(config._band_delay));
   band_s = bs[t];
+  plan->dst.freq = 0;
+  si5351_plan_cache_reset();
 }
 
 uint32_t
@@ -451,6 +527,35 @@ si5351_get_harmonic_lvl(uint32_t freq){
   return i;
 }
 
+// Return band index for frequency
+uint16_t
+si5351_get_band(uint32_t freq){
+  if (freq < band_s[1].freq) return 1;
+  if (freq <= 1000000U) return 2;
+  return si5351_get_harmonic_lvl(freq);
+}
+
+// Generator ready delay for band (use autotuned value from config if set)
+static int
+si5351_band_delay(uint8_t band, int delay){
+  uint8_t d = band < SI5351_BANDS_MAX ? config._band_delay[band] : 0;
+  return d ? (int)US2ST(d * 10) : delay;
+}
+
+// Generator ready delay after set frequency in band
+static int
+si5351_plan_delay(uint8_t band, uint8_t from_band){
+  if (from_band != band) return DELAY_BANDCHANGE;
+  return si5351_band_delay(band, band_s[band].mode == SI5351_FIXED_PLL ? DELAY_BAND_1_2 : DELAY_BAND_3_4);
+}
+
+// Delays changed, need recalculate prepared data
+void
+si5351_update_timings(void){
+  plan->dst.freq = 0;
+  si5351_plan_cache_reset();
+}
+
 /*
  * Maximum supported frequency = FREQ_HARMONICS * 9U
  * configure output as follows:
@@ -462,12 +567,13 @@ si5351_get_harmonic_lvl(uint32_t freq){
 #define FREQ_CHANNEL         1
 #define AUDIO_CODEC_CHANNEL  2
 
-int
-si5351_set_frequency(uint32_t freq, uint8_t drive_strength)
+//
+// Calculate all generator registers for freq from src generator state, not send any data to si5351
+//
+static void
+si5351_calc_plan(si5351_plan_t *p, const si5351_state_t *src, uint32_t freq, uint8_t drive_strength)
 {
   uint8_t band;
-  int delay = 0;
-  if (freq == 0) return 0;
   uint32_t rdiv = 0;
   uint32_t fdiv, pll_n;
   uint32_t ofreq = freq + IF_OFFSET;
@@ -492,26 +598,22 @@ si5351_set_frequency(uint32_t freq, uint8_t drive_strength)
 
   }
 #endif
-  // Check current power settings
-  if (current_power != drive_strength) {
-    si5351_reset_cache();
-    current_power = drive_strength;
-  }
-
-  if (freq == current_freq)
-    return DELAY_CHANNEL_CHANGE;
+  wr_plan = p;
+  p->dst = *src;
+  p->len = 0;
+  // Check current power settings (on change need full registers update)
+  uint8_t  from_band = src->band;
+  uint32_t from_freq = src->freq;
+  if (src->power != drive_strength)
+    from_band = from_freq = 0;
+  p->dst.freq  = freq;
+  p->dst.power = drive_strength;
+  p->dst.band  = from_band;
+  p->from_band = from_band;
+  p->delay     = DELAY_CHANNEL_SWITCH;
+  if (freq == from_freq)
+    return;
 
-  if (current_band != band) {
-//   si5351_write(SI5351_REG_3_OUTPUT_ENABLE_CONTROL, SI5351_CLK0_EN|SI5351_CLK1_EN|SI5351_CLK2_EN);
-    if (DELAY_RESET_PLL_BEFORE)
-      si5351_reset_pll(SI5351_PLL_RESET_A | SI5351_PLL_RESET_B);
-    // Set new gain values
-    if (band_s[current_band].l_gain != band_s[band].l_gain || band_s[current_band].r_gain != band_s[band].r_gain)
-      tlv320aic3204_set_gain(band_s[band].l_gain, band_s[band].r_gain);
-    // Add delay
-    if (DELAY_RESET_PLL_BEFORE)
-      chThdSleepMicroseconds(DELAY_RESET_PLL_BEFORE);
-  }
   uint32_t mul  = band_s[band].mul;
   uint32_t omul = band_s[band].omul;
   uint8_t  ds   = drive_strength;
@@ -522,12 +624,11 @@ si5351_set_frequency(uint32_t freq, uint8_t drive_strength)
     case SI5351_FIXED_PLL: // 10kHz to 100MHz  PLLN = 32
       pll_n = band_s[band].pll_n;
       // Setup CH0 and CH1 constant PLLA freq at band change, and set CH2 freq = CLK2_FREQUENCY
-      if (current_band != band) {
+      if (from_band != band) {
         si5351_setupPLL(SI5351_REG_PLL_A,   pll_n<<7, 0, 1);
         si5351_setupPLL(SI5351_REG_PLL_B, PLL_N_2<<7, 0, 1);
         si5351_set_frequency_fixedpll(AUDIO_CODEC_CHANNEL, config._xtal_freq * PLL_N_2, CLK2_FREQUENCY, 0, SI5351_CLK_DRIVE_STRENGTH_2MA | SI5351_CLK_PLL_SELECT_B);
       }
-      delay = DELAY_BAND_1_2;
       // Calculate and set CH0 and CH1 divider
       si5351_set_frequency_fixedpll(OFREQ_CHANNEL, (uint64_t)omul * config._xtal_freq * pll_n, ofreq, rdiv, ods | SI5351_CLK_PLL_SELECT_A);
       si5351_set_frequency_fixedpll( FREQ_CHANNEL, (uint64_t) mul * config._xtal_freq * pll_n,  freq, rdiv,  ds | SI5351_CLK_PLL_SELECT_A);
@@ -537,20 +638,19 @@ si5351_set_frequency(uint32_t freq, uint8_t drive_strength)
       fdiv  = band_s[band].div;
       pll_n = 32;
       // Calculate and set fixed PLL frequency for CH0 freq+offset
-      if (band_s[current_band].div != band_s[band].div)
+      if (band_s[from_band].div != band_s[band].div)
         si5351_setupPLL(SI5351_REG_PLL_A, pll_n, 0, 1);
       // Calculate and set variable PLL frequency for CH1 freq
       si5351_setupPLL_freq(SI5351_REG_PLL_B, (uint64_t)freq * fdiv,  mul);  // set PLLB freq = ( freq/ mul)*fdiv
 
       // Setup CH1 constant fdiv divider at change
-      if (band_s[current_band].div != band_s[band].div)
+      if (band_s[from_band].div != band_s[band].div)
         si5351_setupMultisynth(FREQ_CHANNEL, fdiv<<7, 0, 1, rdiv, ds | SI5351_CLK_PLL_SELECT_B);
 
       // Set CH0 divider
       si5351_set_frequency_fixedpll(OFREQ_CHANNEL, (uint64_t)omul * config._xtal_freq * pll_n, ofreq, rdiv, ods | SI5351_CLK_PLL_SELECT_A);
       // Calculate CH2 freq = CLK2_FREQUENCY, depend from calculated before CH1 PLLB = (freq/mul)*fdiv
       si5351_set_frequency_fixedpll(AUDIO_CODEC_CHANNEL, (uint64_t)freq * fdiv, CLK2_FREQUENCY * mul, rdiv, SI5351_CLK_DRIVE_STRENGTH_2MA | SI5351_CLK_PLL_SELECT_B);
-      delay= DELAY_BAND_3_4;
     break;
 #endif
                              // fdiv = 8, f 100-130   PLL 800-1040
@@ -561,25 +661,229 @@ si5351_set_frequency(uint32_t freq, uint8_t drive_strength)
       si5351_setupPLL_freq(SI5351_REG_PLL_A, (uint64_t)ofreq * fdiv, omul);  // set PLLA freq = (ofreq/omul)*fdiv
       si5351_setupPLL_freq(SI5351_REG_PLL_B, (uint64_t) freq * fdiv,  mul);  // set PLLB freq = ( freq/ mul)*fdiv
       // Setup CH0 and CH1 constant fdiv divider at change
-      if (band_s[current_band].div != band_s[band].div) {
+      if (band_s[from_band].div != band_s[band].div) {
         si5351_setupMultisynth(OFREQ_CHANNEL, fdiv<<7, 0, 1, rdiv, ods | SI5351_CLK_PLL_SELECT_A);
         si5351_setupMultisynth( FREQ_CHANNEL, fdiv<<7, 0, 1, rdiv,  ds | SI5351_CLK_PLL_SELECT_B);
       }
       // Calculate CH2 freq = CLK2_FREQUENCY, depend from calculated before CH1 PLLB = (freq/mul)*fdiv
       si5351_set_frequency_fixedpll(AUDIO_CODEC_CHANNEL, (uint64_t)freq * fdiv, CLK2_FREQUENCY * mul, rdiv, SI5351_CLK_DRIVE_STRENGTH_2MA | SI5351_CLK_PLL_SELECT_B);
-      delay= DELAY_BAND_3_4;
       break;
   }
-  if (current_band != band) {
+  p->dst.band = band;
+  p->delay    = si5351_plan_delay(band, from_band);
+}
+
+static bool si5351_state_equal(const si5351_state_t *a, const si5351_state_t *b) {
+  return a->freq   == b->freq   && a->band   == b->band   && a->power  == b->power &&
+         a->clk[0] == b->clk[0] && a->clk[1] == b->clk[1] && a->clk[2] == b->clk[2];
+}
+
+//
+// Send prepared registers to generator, return generator ready delay
+//
+static int
+si5351_apply_plan(const si5351_plan_t *p)
+{
+  uint8_t band = p->dst.band;
+  uint8_t from_band = p->from_band;
+  if (from_band != band) {
+//   si5351_write(SI5351_REG_3_OUTPUT_ENABLE_CONTROL, SI5351_CLK0_EN|SI5351_CLK1_EN|SI5351_CLK2_EN);
+    if (DELAY_RESET_PLL_BEFORE)
+      si5351_reset_pll(SI5351_PLL_RESET_A | SI5351_PLL_RESET_B);
+    // Set new gain values
+    if (band_s[from_band].l_gain != band_s[band].l_gain || band_s[from_band].r_gain != band_s[band].r_gain)
+      tlv320aic3204_set_gain(band_s[band].l_gain, band_s[band].r_gain);
+    // Add delay
+    if (DELAY_RESET_PLL_BEFORE) {
+      i2c_wait();
+      chThdSleepMicroseconds(DELAY_RESET_PLL_BEFORE);
+    }
+  }
+  // Send prepared registers
+  const uint8_t *b = p->buf, *end = &p->buf[p->len];
+  for (; b < end; b+= *b + 1)
+    si5351_bulk_write(b + 1, *b);
+  if (from_band != band) {
 //    si5351_write(SI5351_REG_3_OUTPUT_ENABLE_CONTROL, ~(SI5351_CLK0_EN|SI5351_CLK1_EN|SI5351_CLK2_EN));
     // Possibly not need add delay now
     if (DELAY_RESET_PLL_AFTER){
+#ifdef __USE_SI5351_LOCK_WAIT__
+      si5351_wait_pll_lock(US2ST(DELAY_RESET_PLL_AFTER));
+#else
+      i2c_wait();
       chThdSleepMicroseconds(DELAY_RESET_PLL_AFTER);
+#endif
       si5351_reset_pll(SI5351_PLL_RESET_A|SI5351_PLL_RESET_B);
     }
-    current_band = band;
-    delay = DELAY_BANDCHANGE;
+#ifdef __USE_SI5351_LOCK_WAIT__
+    // PLL locked, use short delay (sweep check signal stability), else use fixed delay
+    gen = p->dst;
+    if (si5351_wait_pll_lock(DELAY_BANDCHANGE)) {
+      pll_relocked = true;
+      return si5351_band_delay(band, DELAY_BAND_3_4);
+    }
+    return p->delay;
+#endif
   }
-  current_freq = freq;
-  return delay;
+  gen = p->dst;
+  return p->delay;
+}
+
+//
+// Calculate registers for freq, not send any data to si5351
+// Sweep use it for prepare next point while DSP process current
+//
+void
+si5351_prepare_frequency(uint32_t freq, uint8_t drive_strength)
+{
+  if (freq == 0) return;
+  plan_src = gen;
+  si5351_calc_plan(plan, &plan_src, freq, drive_strength);
 }
+
+//
+// Set generator frequency, use prepared registers if they valid for current generator state
+// Return generator ready delay
+//
+int
+si5351_set_frequency(uint32_t freq, uint8_t drive_strength)
+{
+  if (freq == 0) return 0;
+  if (plan->dst.freq != freq || plan->dst.power != drive_strength || !si5351_state_equal(&plan_src, &gen))
+    si5351_prepare_frequency(freq, drive_strength);
+  return si5351_apply_plan(plan);
+}
+
+#ifdef __USE_FREQ_PLAN_CACHE__
+// PLL A, PLL B, multisynth 0-2 parameters groups (8 registers from SI5351_REG_PLL_A)
+#define SI5351_PLAN_GROUPS   5
+
+// Register block data size by start register (CLKx control - 1 byte, PLL and multisynth - up to group end)
+static uint8_t si5351_block_size(uint8_t reg) {
+  return reg < SI5351_REG_PLL_A ? 1 : 8 - (reg - SI5351_REG_PLL_A) % 8;
+}
+
+// Pack prepared plan to cache, skip parameters registers not changed from previous point (only if group written on it)
+// Return packed size (0 if no space or plan can`t be packed)
+static uint16_t si5351_plan_pack(uint8_t *e, uint16_t size, uint8_t shadow[SI5351_PLAN_GROUPS][8], uint8_t *written) {
+  if (plan->len + 2 > size) return 0;
+  uint8_t *d = e + 2, mask = 0;
+  const uint8_t *b = plan->buf, *end = &plan->buf[plan->len];
+  for (; b < end; b+= *b + 1) {
+    uint8_t reg = b[1], n = *b - 1, k = 0;
+    if (si5351_block_size(reg) != n) return 0;
+    if (reg >= SI5351_REG_PLL_A) {
+      uint8_t g = (reg - SI5351_REG_PLL_A) / 8;
+      if (*written & (1<<g))
+        while (k < n - 1 && b[2 + k] == shadow[g][k]) k++;  // last register always written (it apply group change)
+      memcpy(shadow[g], &b[2], 8);
+      mask|= 1<<g;
+    }
+    *d++ = reg + k;
+    memcpy(d, &b[2 + k], n - k);
+    d+= n - k;
+  }
+  e[0] = plan->dst.band;
+  e[1] = d - e - 2;
+  *written = mask;
+  return d - e;
+}
+
+//
+// Build sweep frequencies plan cache (chain of plans, every point calculated from previous point state)
+//
+void
+si5351_plan_cache_build(uint16_t points, uint32_t (*get_freq)(uint16_t idx), uint8_t drive_strength)
+{
+  uint32_t start = get_freq(0), stop = get_freq(points - 1);
+  if (plan_cache.valid && plan_cache.power == drive_strength && plan_cache.count == points &&
+      plan_cache.start == start && plan_cache.stop == stop && plan_cache.threshold == config._harmonic_freq_threshold)
+    return;
+  // Generator state after last point used as source for first, calculate it by sweep from current state
+  // (registers of channels not changed in band depend from previous bands, so need go all points)
+  si5351_state_t state = gen;
+  uint16_t i;
+  for (i = 0; i < points; i++) {
+    si5351_calc_plan(plan, &state, get_freq(i), drive_strength);
+    state = plan->dst;
+  }
+  plan_cache.src = state;
+  uint8_t shadow[SI5351_PLAN_GROUPS][8];
+  uint8_t written = 0;
+  uint16_t offset = 0, size;
+  for (i = 0; i < points; i++) {
+    si5351_calc_plan(plan, &state, get_freq(i), drive_strength);
+    if ((size = si5351_plan_pack(&plan_cache_pool[offset], PLAN_CACHE_POOL_SIZE - offset, shadow, &written)) == 0)
+      break;
+    offset+= size;
+    state = plan->dst;
+  }
+  plan->dst.freq = 0;
+  plan_cache.points       = i;
+  plan_cache.count        = points;
+  plan_cache.start        = start;
+  plan_cache.stop         = stop;
+  plan_cache.threshold    = config._harmonic_freq_threshold;
+  plan_cache.power        = drive_strength;
+  plan_cache.next         = 0;
+  plan_cache.valid        = true;
+}
+
+// Unpack cached point to prepared plan if it valid for current generator state
+// Cache read sequentially, on not valid state point skipped (set as usual), next point check state again
+static bool si5351_plan_cache_load(uint16_t idx, uint32_t freq, uint8_t drive_strength) {
+  if (!plan_cache.valid || idx >= plan_cache.points || plan_cache.power != drive_strength)
+    return false;
+  if (idx == 0) {plan_cache.next = plan_cache.rd = 0; plan_cache.last = plan_cache.src;}
+  if (idx != plan_cache.next)
+    return false;
+  bool valid = si5351_state_equal(&plan_cache.last, &gen);
+  const uint8_t *e = &plan_cache_pool[plan_cache.rd], *b = e + 2, *end = b + e[1];
+  si5351_state_t dst = plan_cache.last;
+  dst.freq = freq;
+  dst.band = e[0];
+  if (valid) {
+    plan_src = gen;
+    plan->from_band = gen.band;
+    plan->delay     = e[1] ? si5351_plan_delay(e[0], gen.band) : DELAY_CHANNEL_SWITCH;
+    plan->len       = 0;
+  }
+  while (b < end) {
+    uint8_t n = si5351_block_size(*b) + 1;
+    if (*b < SI5351_REG_PLL_A) dst.clk[*b - SI5351_REG_16_CLK0_CONTROL] = b[1];
+    if (valid) {
+      plan->buf[plan->len++] = n;
+      memcpy(&plan->buf[plan->len], b, n);
+      plan->len+= n;
+    }
+    b+= n;
+  }
+  if (valid) plan->dst = dst;
+  plan_cache.rd   = end - plan_cache_pool;
+  plan_cache.next = idx + 1;
+  plan_cache.last = dst;
+  return valid;
+}
+
+//
+// Set sweep point frequency, use cached registers if possible
+//
+int
+si5351_set_sweep_frequency(uint16_t idx, uint32_t freq, uint8_t drive_strength)
+{
+  if (si5351_plan_cache_load(idx, freq, drive_strength))
+    return si5351_apply_plan(plan);
+  return si5351_set_frequency(freq, drive_strength);
+}
+
+//
+// Prepare sweep point registers (not need if cached, loaded on set)
+//
+void
+si5351_prepare_sweep_frequency(uint16_t idx, uint32_t freq, uint8_t drive_strength)
+{
+  if (plan_cache.valid && idx == plan_cache.next && idx < plan_cache.points && plan_cache.power == drive_strength)
+    return;
+  si5351_prepare_frequency(freq, drive_strength);
+}
+#endif
@@ -19,6 +19,12 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#define SI5351_REG_0_DEVICE_STATUS          0
+#define SI5351_STATUS_SYS_INIT  (1<<7)
+#define SI5351_STATUS_LOL_B     (1<<6)
+#define SI5351_STATUS_LOL_A     (1<<5)
+#define SI5351_STATUS_LOS       (1<<4)
+
 #define SI5351_REG_3_OUTPUT_ENABLE_CONTROL  3
 #define SI5351_CLK0_EN     (1<<0)
 #define SI5351_CLK1_EN     (1<<1)
@@ -80,8 +86,17 @@ void si5351_enable_output(void);
 
 void si5351_set_frequency_offset(int32_t offset);
 int  si5351_set_frequency(uint32_t freq, uint8_t drive_strength);
+void si5351_prepare_frequency(uint32_t freq, uint8_t drive_strength);
+// Sweep frequencies registers cache (if __USE_FREQ_PLAN_CACHE__ enabled)
+void si5351_plan_cache_reset(void);
+void si5351_plan_cache_build(uint16_t points, uint32_t (*get_freq)(uint16_t idx), uint8_t drive_strength);
+int  si5351_set_sweep_frequency(uint16_t idx, uint32_t freq, uint8_t drive_strength);
+void si5351_prepare_sweep_frequency(uint16_t idx, uint32_t freq, uint8_t drive_strength);
 void si5351_set_power(uint8_t drive_strength);
 void si5351_set_band_mode(uint16_t t);
+bool si5351_pll_relocked(void);
+uint16_t si5351_get_band(uint32_t freq);
+void si5351_update_timings(void);
 
 // Defug use functions
 void si5351_bulk_write(const uint8_t *buf, int len);
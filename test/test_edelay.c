@@ -0,0 +1,62 @@
+/*
+ * Electrical delay phasor rotator test: apply delay to sweep points by rotator
+ * and compare with double precision exp(j*2*pi*delay*f)
+ */
+#include <stdio.h>
+#include <math.h>
+#include "hal.h"
+#include "nanovna.h"
+
+#include "../vna_modules/vna_edelay.c"
+
+// Max allowed error of rotated unit vector
+#define EDELAY_ERROR_LIMIT  1e-5
+
+// Sweep frequency (same as getFrequency without frequency table)
+static freq_t sweep_frequency(freq_t start, freq_t stop, uint16_t points, uint16_t idx) {
+  freq_t span = stop - start, n = points - 1;
+  return start + (span / n) * idx + (n / 2 + (span % n) * idx) / n;
+}
+
+// Run sweep with delay on channel, step - index increment (1 - normal sweep, else sweep restarted on break)
+static double run(freq_t start, freq_t stop, uint16_t points, float delay, int ch, int step) {
+  double err = 0.0;
+  edelay_df = (sweep_frequency(start, stop, points, points - 1) - start) / (points - 1);
+  for (int i = 0; i < points; i+= (i % 37 == 36) ? step : 1) {
+    freq_t f = sweep_frequency(start, stop, points, i);
+    float data[2] = {1.0f, 0.0f};
+    applyEDelayPoint(ch, delay, f, data);
+    double w = 2.0 * M_PI * fmod((double)delay * f, 1.0);
+    err = fmax(err, hypot(data[0] - cos(w), data[1] - sin(w)));
+  }
+  return err;
+}
+
+int main(void) {
+  static const struct {freq_t start, stop;} ranges[] = {
+    {    50000,  900000000},
+    {  1000000, 1500000000},
+    {100000000, 2700000000U},
+    { 10000000,   10001000},
+  };
+  static const uint16_t points[] = {11, 101, 201, SWEEP_POINTS_MAX};
+  static const float delays[] = {1e-9f, 12.345e-9f, 100e-9f, 1e-6f, -37e-9f, 10e-6f};
+  double max = 0.0;
+  int errors = 0;
+  for (uint32_t r = 0; r < ARRAY_COUNT(ranges); r++)
+  for (uint32_t p = 0; p < ARRAY_COUNT(points); p++)
+  for (uint32_t d = 0; d < ARRAY_COUNT(delays); d++) {
+    // All rotators (e-delay and port extension), normal sweep, sweep with skipped points, repeated sweep with same settings
+    double err = run(ranges[r].start, ranges[r].stop, points[p], delays[d], d % ARRAY_COUNT(edelay_rot), 1);
+    err = fmax(err, run(ranges[r].start, ranges[r].stop, points[p], delays[d], d % ARRAY_COUNT(edelay_rot), 3));
+    err = fmax(err, run(ranges[r].start, ranges[r].stop, points[p], delays[d], d % ARRAY_COUNT(edelay_rot), 1));
+    if (!(err < EDELAY_ERROR_LIMIT)) {
+      printf("%10u - %10u %3u points delay %g: error %.2e FAIL\n", ranges[r].start, ranges[r].stop, points[p], delays[d], err);
+      errors++;
+    }
+    max = fmax(max, err);
+  }
+  printf("rotator max error %.2e (limit %.0e)\n", max, EDELAY_ERROR_LIMIT);
+  printf(errors ? "FAIL\n" : "OK\n");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * Port Z renormalization test: convert S parameters measured on calibration load R0
+ * to complex port 1 impedance and compare with reference values (power waves definition)
+ */
+#include <stdio.h>
+#include <math.h>
+#include <complex.h>
+#include "hal.h"
+#include "nanovna.h"
+
+#define SWEEP_CH0_MEASURE           (1<< 0)
+#define SWEEP_CH1_MEASURE           (1<< 1)
+
+#ifdef __VNA_Z_RENORMALIZATION__
+properties_t current_props;
+
+// Host build not use FPU square root instruction
+#undef  vna_sqrtf
+#define vna_sqrtf  sqrtf
+
+#include "../vna_modules/vna_renorm.c"
+
+// Max allowed error of renormalized S parameters
+#define RENORM_ERROR_LIMIT  1e-5
+
+// Calculated values: DUT series Z between port 1 and port 2
+//   measured on R0:                  S11 = Z / (Z + 2*R0), S21 = 2*R0 / (Z + 2*R0)
+//   port 1 Zr = R + jX, port 2 R0:   S11'= (Z + R0 - Zr*) / (Z + R0 + Zr), S21' = 2*sqrt(R0*R) / (Z + R0 + Zr)
+static const struct {float r0, r, x; float s[4]; float ref[4];} values[] = {
+  {50.0f,  50.0f,   0.0f, {0.2485549f, 0.1156069f, 0.7514451f,-0.1156069f}, { 0.2485549f, 0.1156069f, 0.7514451f,-0.1156069f}},
+  {50.0f,  75.0f,   0.0f, {0.2000000f, 0.0000000f, 0.8000000f, 0.0000000f}, { 0.0000000f, 0.0000000f, 0.8164966f, 0.0000000f}},
+  {50.0f,  75.0f,   0.0f, {0.0000000f, 0.0000000f, 1.0000000f, 0.0000000f}, {-0.2000000f, 0.0000000f, 0.9797959f, 0.0000000f}},
+  {50.0f,  25.0f,  30.0f, {0.0825688f,-0.2752294f, 0.9174312f, 0.2752294f}, { 0.3333333f, 0.0000000f, 0.9428090f, 0.0000000f}},
+  {75.0f,  50.0f,   0.0f, {0.4230769f,-0.1153846f, 0.5769231f, 0.1153846f}, { 0.5764706f,-0.0941176f, 0.5187155f, 0.1152701f}},
+  {49.5f, 100.0f, -60.0f, {0.0936503f, 0.0415757f, 0.9063497f,-0.0415757f}, {-0.1206647f,-0.3864361f, 0.7884575f, 0.2718819f}},
+};
+
+static void set_port(float r0, float r, float x) {
+  cal_load_r = r0;
+  current_props._portz   = r;
+  current_props._portz_x = x;
+  renorm_update();
+}
+
+static double error(const float *d, const float *ref, int n) {
+  double err = 0.0;
+  for (int i = 0; i < n; i+= 2)
+    err = fmax(err, hypot(d[i] - ref[i], d[i + 1] - ref[i + 1]));
+  return err;
+}
+
+int main(void) {
+  double max = 0.0;
+  int errors = 0;
+  // Reference values
+  for (uint32_t i = 0; i < ARRAY_COUNT(values); i++) {
+    float d[4] = {values[i].s[0], values[i].s[1], values[i].s[2], values[i].s[3]};
+    set_port(values[i].r0, values[i].r, values[i].x);
+    apply_renormalization(d, SWEEP_CH0_MEASURE | SWEEP_CH1_MEASURE);
+    double err = error(d, values[i].ref, 4);
+    if (!(err < RENORM_ERROR_LIMIT)) {
+      printf("R0 %g Zr %g%+gj: S11 %f%+fj (ref %f%+fj) S21 %f%+fj (ref %f%+fj) FAIL\n", values[i].r0, values[i].r, values[i].x,
+        d[0], d[1], values[i].ref[0], values[i].ref[1], d[2], d[3], values[i].ref[2], values[i].ref[3]);
+      errors++;
+    }
+    max = fmax(max, err);
+  }
+  // Impedance grid, reference calculated in double
+  static const float r0s[] = {50.0f, 49.5f, 75.0f};
+  static const float zr[][2] = {{50.0f, 0.0f}, {75.0f, 0.0f}, {25.0f, 30.0f}, {100.0f, -60.0f}, {50.0f, 10.0f}, {5.0f, 200.0f}};
+  static const double complex zs[] = {10 + 5*I, 50, 200 - 100*I, 3 + 80*I, 1000 + 1000*I, 0.5 - 2*I};
+  for (uint32_t a = 0; a < ARRAY_COUNT(r0s); a++)
+  for (uint32_t b = 0; b < ARRAY_COUNT(zr); b++) {
+    double r0 = r0s[a];
+    double complex z_r = zr[b][0] + zr[b][1] * I;
+    set_port(r0s[a], zr[b][0], zr[b][1]);
+    for (uint32_t z = 0; z < ARRAY_COUNT(zs); z++) {
+      double complex s11 = zs[z] / (zs[z] + 2 * r0), s21 = 2 * r0 / (zs[z] + 2 * r0);
+      double complex r11 = (zs[z] + r0 - conj(z_r)) / (zs[z] + r0 + z_r), r21 = 2 * sqrt(r0 * zr[b][0]) / (zs[z] + r0 + z_r);
+      float ref[4] = {creal(r11), cimag(r11), creal(r21), cimag(r21)};
+      float d[4] = {creal(s11), cimag(s11), creal(s21), cimag(s21)};
+      apply_renormalization(d, SWEEP_CH0_MEASURE | SWEEP_CH1_MEASURE);
+      double err = error(d, ref, 4);
+      // S11 only measure, S21 must not change
+      float s[4] = {creal(s11), cimag(s11), 1.0f, 2.0f};
+      apply_renormalization(s, SWEEP_CH0_MEASURE);
+      err = fmax(err, error(s, ref, 2));
+      err = fmax(err, hypot(s[2] - 1.0f, s[3] - 2.0f));
+      if (!(err < RENORM_ERROR_LIMIT)) {
+        printf("R0 %g Zr %g%+gj Z %g%+gj: error %.2e FAIL\n", r0s[a], zr[b][0], zr[b][1], creal(zs[z]), cimag(zs[z]), err);
+        errors++;
+      }
+      max = fmax(max, err);
+    }
+  }
+  printf("renormalization max error %.2e (limit %.0e)\n", max, RENORM_ERROR_LIMIT);
+  printf(errors ? "FAIL\n" : "OK\n");
+  return errors ? 1 : 0;
+}
+#else
+int main(void) {
+  printf("renormalization disabled, skip\n");
+  return 0;
+}
+#endif
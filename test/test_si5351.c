@@ -0,0 +1,150 @@
+/*
+ * Si5351 sweep plan cache test: run sweeps by cached and not cached path and
+ * compare generator registers image and ready delays after every point
+ * Plan cache placed in CCM buffer, so test build only for F303
+ */
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "nanovna.h"
+#include "si5351.h"
+
+// Replace RTOS timing, test run on host
+#undef  chThdSleepMicroseconds
+#define chThdSleepMicroseconds(us)
+#define chVTGetSystemTimeX()         0
+#define chVTTimeElapsedSinceX(t)     ((void)(t), 0)
+
+#include "../si5351.c"
+
+#ifndef __USE_FREQ_PLAN_CACHE__
+#error "Plan cache test need __USE_FREQ_PLAN_CACHE__ (F303 only)"
+#endif
+
+config_t config;
+float ccm_buffer[CCM_BUFFER_SIZE / sizeof(float)];
+uint16_t ccm_cache_size(void) {return CCM_BUFFER_SIZE;}
+
+// Generator registers image (filled by I2C writes)
+static uint8_t regs[256];
+static uint32_t write_bytes;
+
+bool i2c_transfer(uint8_t addr, const uint8_t *w, size_t wn) {
+  if (addr == SI5351_I2C_ADDR && wn > 1)
+    memcpy(&regs[w[0]], &w[1], wn - 1);
+  write_bytes+= wn;
+  return true;
+}
+bool i2c_receive(uint8_t addr, const uint8_t *w, size_t wn, uint8_t *r, size_t rn) {
+  (void)addr; (void)w; (void)wn;
+  memset(r, 0, rn);  // PLL locked
+  return true;
+}
+void i2c_wait(void) {}
+void tlv320aic3204_set_gain(uint8_t lgain, uint8_t rgain) {(void)lgain; (void)rgain;}
+void generate_DSP_Table(int offset) {(void)offset;}
+
+static uint32_t hits;
+static freq_t f_start, f_stop;
+static uint16_t f_points;
+static uint32_t get_freq(uint16_t idx) {
+  return f_start + (freq_t)(((uint64_t)(f_stop - f_start) * idx + (f_points - 1) / 2) / (f_points - 1));
+}
+
+// Run sweeps and store registers image and delay for every point
+#define SWEEPS 3
+static uint8_t image[SWEEPS * SWEEP_POINTS_MAX][256];
+static int     delay[SWEEPS * SWEEP_POINTS_MAX];
+
+static void generator_reset(void) {
+  memset(regs, 0, sizeof(regs));
+  si5351_reset_cache();
+  gen.power = 0;
+  memset(gen.clk, 0, sizeof(gen.clk));
+  si5351_set_frequency(XTALFREQ, 0);
+}
+
+static void run(bool cached, uint8_t power) {
+  generator_reset();
+  write_bytes = hits = 0;
+  int n = 0;
+  for (int s = 0; s < SWEEPS; s++) {
+    if (cached) si5351_plan_cache_build(f_points, get_freq, power);
+    for (int i = 0; i < f_points; i++, n++) {
+      if (cached) {
+        // Same as si5351_set_sweep_frequency, but count cache hits
+        if (si5351_plan_cache_load(i, get_freq(i), power)) {
+          delay[n] = si5351_apply_plan(plan);
+          hits++;
+        } else
+          delay[n] = si5351_set_frequency(get_freq(i), power);
+        if (i + 1 < f_points) si5351_prepare_sweep_frequency(i + 1, get_freq(i + 1), power);
+      } else
+        delay[n] = si5351_set_frequency(get_freq(i), power);
+      memcpy(image[n], regs, sizeof(regs));
+    }
+  }
+}
+
+int main(void) {
+  static const struct {freq_t start, stop; uint16_t points;} sweeps[] = {
+    {     50000,  900000000, SWEEP_POINTS_MAX},
+    {     10000,    1000000, SWEEP_POINTS_MAX},
+    {   1000000,   30000000, SWEEP_POINTS_MAX},
+    { 140000000,  160000000, SWEEP_POINTS_MAX},
+    { 300000000, 2700000000U, SWEEP_POINTS_MAX},
+    {   7000000,    7000000, 101},
+    {  88000000,  108000000, 21},
+  };
+  static const uint8_t powers[] = {SI5351_CLK_DRIVE_STRENGTH_AUTO, SI5351_CLK_DRIVE_STRENGTH_2MA};
+  static uint8_t ref_image[SWEEPS * SWEEP_POINTS_MAX][256];
+  static int     ref_delay[SWEEPS * SWEEP_POINTS_MAX];
+  int errors = 0;
+  config._xtal_freq = XTALFREQ;
+  config._harmonic_freq_threshold = FREQUENCY_THRESHOLD;
+  config._IF_freq = FREQUENCY_OFFSET;
+  si5351_set_band_mode(0);
+  for (uint32_t w = 0; w < sizeof(sweeps) / sizeof(sweeps[0]); w++)
+  for (uint32_t p = 0; p < sizeof(powers); p++) {
+    f_start = sweeps[w].start; f_stop = sweeps[w].stop; f_points = sweeps[w].points;
+    si5351_plan_cache_reset();
+    run(false, powers[p]);
+    uint32_t ref_bytes = write_bytes;
+    memcpy(ref_image, image, sizeof(image));
+    memcpy(ref_delay, delay, sizeof(delay));
+    run(true, powers[p]);
+    int bad = 0;
+    for (int n = 0; n < SWEEPS * f_points; n++)
+      if (memcmp(ref_image[n], image[n], 256) != 0 || ref_delay[n] != delay[n]) bad++;
+    printf("%10u - %10u %3u points power %u: cached %3u points, hits %4u/%4u, i2c bytes %6u/%6u, mismatch %d\n",
+      f_start, f_stop, f_points, powers[p], plan_cache.points, hits, SWEEPS * f_points,
+      write_bytes, ref_bytes, bad);
+    errors+= bad;
+  }
+  // Cache build with other harmonic threshold must be rebuilt
+  f_start = 50000; f_stop = 900000000; f_points = SWEEP_POINTS_MAX;
+  run(false, SI5351_CLK_DRIVE_STRENGTH_AUTO);
+  memcpy(ref_image, image, sizeof(image));
+  memcpy(ref_delay, delay, sizeof(delay));
+  config._harmonic_freq_threshold = 200000000U;
+  si5351_plan_cache_reset();
+  si5351_plan_cache_build(f_points, get_freq, SI5351_CLK_DRIVE_STRENGTH_AUTO);
+  config._harmonic_freq_threshold = FREQUENCY_THRESHOLD;
+  run(true, SI5351_CLK_DRIVE_STRENGTH_AUTO);
+  int bad = 0;
+  for (int n = 0; n < SWEEPS * f_points; n++)
+    if (memcmp(ref_image[n], image[n], 256) != 0 || ref_delay[n] != delay[n]) bad++;
+  printf("harmonic threshold change: hits %4u/%4u, mismatch %d\n", hits, SWEEPS * f_points, bad);
+  errors+= bad;
+  // Autotuned band delays reset on band plan change, kept on same plan
+  config._band_delay[3] = 20;
+  si5351_set_band_mode(0);
+  bad = config._band_delay[3] != 20;
+  si5351_set_band_mode(1);
+  bad+= config._band_delay[3] != 0;
+  si5351_set_band_mode(0);
+  printf("band mode change: band delay mismatch %d\n", bad);
+  errors+= bad;
+  printf(errors ? "FAIL\n" : "OK\n");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * FFT test: compare fft_ex, fft_inverse_real and fft_inverse_pruned with double precision DFT,
+ * check half float pack/unpack,
+ * and measure throughput (host time, only for compare implementations)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "../vna_math.c"
+
+// Max allowed error relative to max output value
+#define FFT_ERROR_LIMIT  2e-6
+
+static float  data[2 * FFT_SIZE_MAX][2];
+static float  src[2 * FFT_SIZE_MAX][2];
+static double ref[2 * FFT_SIZE_MAX][2];
+
+static void fill_random(float (*x)[2], int n) {
+  for (int i = 0; i < n; i++) {
+    x[i][0] = rand() / (float)RAND_MAX - 0.5f;
+    x[i][1] = rand() / (float)RAND_MAX - 0.5f;
+  }
+}
+
+// dir = 0:forward (exp(-j)), 1:inverse (exp(+j)), not normalized
+static void dft(const float (*x)[2], double (*y)[2], int n, int dir) {
+  for (int k = 0; k < n; k++) {
+    double re = 0.0, im = 0.0;
+    for (int i = 0; i < n; i++) {
+      double a = (dir ? 2.0 : -2.0) * M_PI * ((long)k * i % n) / n, c = cos(a), s = sin(a);
+      re+= x[i][0] * c - x[i][1] * s;
+      im+= x[i][0] * s + x[i][1] * c;
+    }
+    y[k][0] = re; y[k][1] = im;
+  }
+}
+
+// Max error relative to max reference value
+static double compare(const float *x, const double *y, int n) {
+  double err = 0.0, max = 0.0;
+  for (int i = 0; i < n; i++) {
+    err = fmax(err, fabs(x[i] - y[i]));
+    max = fmax(max, fabs(y[i]));
+  }
+  return err / max;
+}
+
+static int check(const char *name, int size, double err) {
+  int bad = !(err < FFT_ERROR_LIMIT);
+  printf("%-18s %4d: error %.2e %s\n", name, size, err, bad ? "FAIL" : "");
+  return bad;
+}
+
+// Simple radix-2 FFT (no tables, libm sin/cos for every butterfly) for throughput compare
+static void fft_radix2(float (*x)[2], int n, int dir) {
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) j^= bit;
+    j^= bit;
+    if (i < j) {SWAP(float, x[i][0], x[j][0]); SWAP(float, x[i][1], x[j][1]);}
+  }
+  for (int len = 2; len <= n; len<<= 1) {
+    float a = (dir ? 2.0f : -2.0f) * VNA_PI / len;
+    for (int i = 0; i < n; i+= len) {
+      for (int k = 0; k < len / 2; k++) {
+        float c = cosf(a * k), s = sinf(a * k);
+        float *p = x[i + k], *q = x[i + k + len / 2];
+        float re = q[0] * c - q[1] * s, im = q[0] * s + q[1] * c;
+        q[0] = p[0] - re; q[1] = p[1] - im;
+        p[0]+= re;        p[1]+= im;
+      }
+    }
+  }
+}
+
+#define BENCH_TIME(count, code) ({ \
+  clock_t t = clock(); \
+  for (int r = 0; r < count; r++) {code;} \
+  (double)(clock() - t) * 1e6 / CLOCKS_PER_SEC / count; \
+})
+
+int main(void) {
+  int errors = 0;
+  srand(1);
+  // Complex FFT all sizes, forward and inverse
+  for (int n = 16; n <= FFT_SIZE_MAX; n<<= 1) {
+    for (int dir = 0; dir < 2; dir++) {
+      fill_random(src, n);
+      memcpy(data, src, n * sizeof(data[0]));
+      fft_ex(data, n, dir);
+      dft((const float (*)[2])src, ref, n, dir);
+      errors+= check(dir ? "fft_ex inverse" : "fft_ex forward", n, compare(data[0], ref[0], 2 * n));
+    }
+  }
+  // Real output inverse FFT for 2 channels packed (lowpass time domain)
+  for (int n = 16; n <= FFT_SIZE_MAX; n<<= 1) {
+    const int M = n / 2;
+    double err = 0.0;
+    fill_random(src, 2 * M);
+    for (int ch = 0; ch < 2; ch++) {
+      // Packed input: X[0..M-1], real part of X[M] in imaginary part of X[0]
+      float (*x)[2] = &src[ch * M];
+      memcpy(data[ch * M], x, M * sizeof(data[0]));
+    }
+    fft_inverse_real(data, n, 2);
+    for (int ch = 0; ch < 2; ch++) {
+      // Restore full Hermitian spectrum and made complex iDFT
+      float (*x)[2] = &src[ch * M];
+      static float full[FFT_SIZE_MAX][2];
+      full[0][0] = x[0][0]; full[0][1] = 0.0f;
+      full[M][0] = x[0][1]; full[M][1] = 0.0f;
+      for (int k = 1; k < M; k++) {
+        full[k][0]     = x[k][0]; full[k][1]     = x[k][1];
+        full[n - k][0] = x[k][0]; full[n - k][1] =-x[k][1];
+      }
+      dft((const float (*)[2])full, ref, n, 1);
+      float *out = (float *)data[ch * M];
+      double max = 0.0, e = 0.0;
+      for (int i = 0; i < n; i++) {
+        e   = fmax(e, fabs(out[i] - ref[i][0]));
+        max = fmax(max, fabs(ref[i][0]));
+      }
+      err = fmax(err, e / max);
+    }
+    errors+= check("fft_inverse_real", n, err);
+  }
+#if FFT_SIZE_MAX > FFT_SIZE
+  // Inverse FFT bigger then FFT_SIZE for sweep points input (time domain with big FFT size)
+  for (int n = 2 * FFT_SIZE; n <= FFT_SIZE_MAX; n<<= 1) {
+    static float work[FFT_SIZE][2];
+    const int points = SWEEP_POINTS_MAX;
+    fill_random(src, points);
+    memset(src[points], 0, (n - points) * sizeof(src[0]));
+    fft_inverse_pruned((const float (*)[2])src, points, data, points, n, work);
+    dft((const float (*)[2])src, ref, n, 1);
+    errors+= check("fft_inverse_pruned", n, compare(data[0], ref[0], 2 * points));
+  }
+#endif
+  // Half float pack: truncate error < 2^-10 relative (normal) or 2^-24 (denormal), stochastic rounding not biased
+  {
+    double err = 0.0, bias = 0.0;
+    uint32_t rnd = 1;
+    for (int i = 0; i < 10000; i++) {
+      float v = (rand() / (float)RAND_MAX - 0.5f) * powf(10.0f, rand() % 10 - 7);
+      float h = vna_h2f(vna_f2h(v, 0));
+      err = fmax(err, fabs(h - v) / fmax(fabs(v), 1.0 / (1 << 14)));
+      double sum = 0.0;
+      for (int j = 0; j < 256; j++) {
+        rnd^= rnd << 13; rnd^= rnd >> 17; rnd^= rnd << 5;
+        sum+= vna_h2f(vna_f2h(v, rnd));
+      }
+      bias = fmax(bias, fabs(sum / 256 - v) / fmax(fabs(v), 1.0 / (1 << 14)));
+    }
+    int bad = !(err < 1.0 / (1 << 10) && bias < 1.0 / (1 << 12));
+    printf("half float: error %.2e, stochastic rounding bias %.2e %s\n", err, bias, bad ? "FAIL" : "");
+    errors+= bad;
+  }
+  // Throughput
+  printf("Throughput (host, us per transform):\n");
+  for (int n = 256; n <= FFT_SIZE_MAX; n<<= 1) {
+    int count = 200000 / n;
+    fill_random(data, 2 * n);
+    double t_radix2 = BENCH_TIME(count, fft_radix2(data, n, 1));
+    double t_fft    = BENCH_TIME(count, fft_ex(data, n, 1));
+    double t_2fft   = BENCH_TIME(count, fft_ex(data, n, 1); fft_ex(&data[n], n, 1));
+    double t_real   = BENCH_TIME(count, fft_inverse_real(data, n, 2));
+    printf("%4d: radix-2 %7.2f, fft_ex %7.2f, 2 channels: complex %7.2f real %7.2f\n", n, t_radix2, t_fft, t_2fft, t_real);
+  }
+  printf(errors ? "FAIL\n" : "OK\n");
+  return errors ? 1 : 0;
+}
@@ -114,7 +114,16 @@ enum {
   KM_TOP, KM_nTOP,
   KM_BOTTOM, KM_nBOTTOM,
   KM_SCALE, KM_nSCALE,
-  KM_REFPOS, KM_EDELAY, KM_VAR_DELAY, KM_S21OFFSET, KM_VELOCITY_FACTOR,
+  KM_REFPOS, KM_EDELAY, KM_VAR_DELAY, KM_S21OFFSET, KM_VELOCITY_FACTOR, KM_TD_BETA,
+#ifdef __USE_TD_ZOOM__
+  KM_TD_ZOOM_START, KM_TD_ZOOM_STOP,
+#endif
+#ifdef __USE_TD_GATE__
+  KM_TD_GATE_CENTER, KM_TD_GATE_SPAN,
+#endif
+#ifdef __USE_PORT_EXTENSION__
+  KM_PORTEXT_DELAY, KM_PORTEXT_LOSS0, KM_PORTEXT_LOSS1, KM_PORTEXT_FREQ,
+#endif
 #ifdef __S11_CABLE_MEASURE__
   KM_ACTUAL_CABLE_LEN,
 #endif
@@ -123,7 +132,7 @@ enum {
   KM_MEASURE_R,
 #endif
 #ifdef __VNA_Z_RENORMALIZATION__
-  KM_Z_PORT,
+  KM_Z_PORT, KM_Z_PORT_X,
   KM_CAL_LOAD_R,
 #endif
 #ifdef __USE_RTC__
@@ -965,19 +974,75 @@ static UI_FUNCTION_ADV_CALLBACK(menu_channel_acb) {
     set_trace_channel(current_trace, ch^1);
 }
 
+static const char *get_td_window_name(uint16_t mode) {
+  switch (mode & TD_WINDOW_TYPE) {
+    case TD_WINDOW_HANN:     return "HANN";
+    case TD_WINDOW_BLACKMAN: return "BLACKMAN-H.";
+  }
+  switch (mode & TD_WINDOW) {
+    case TD_WINDOW_MINIMUM: return "MINIMUM";
+    case TD_WINDOW_NORMAL:  return "NORMAL";
+    case TD_WINDOW_MAXIMUM: return "MAXIMUM";
+  }
+  return "KAISER USER";
+}
+
+extern const menuitem_t menu_transform_window[];
 static UI_FUNCTION_ADV_CALLBACK(menu_transform_window_acb) {
-  const char *text = "";
-  switch(props_mode & TD_WINDOW) {
-    case TD_WINDOW_MINIMUM: text = "MINIMUM"; data = TD_WINDOW_NORMAL;  break;
-    case TD_WINDOW_NORMAL:  text = "NORMAL";  data = TD_WINDOW_MAXIMUM; break;
-    case TD_WINDOW_MAXIMUM: text = "MAXIMUM"; data = TD_WINDOW_MINIMUM; break;
+  (void)data;
+  if(b) {
+    b->p1.text = get_td_window_name(props_mode);
+    return;
   }
+  menu_push_submenu(menu_transform_window);
+}
+
+static UI_FUNCTION_ADV_CALLBACK(menu_transform_window_sel_acb) {
+  static const uint16_t td_window_list[] = {
+    TD_WINDOW_KAISER|TD_WINDOW_MINIMUM, TD_WINDOW_KAISER|TD_WINDOW_NORMAL, TD_WINDOW_KAISER|TD_WINDOW_MAXIMUM,
+    TD_WINDOW_KAISER|TD_WINDOW_USER,    TD_WINDOW_HANN,                    TD_WINDOW_BLACKMAN};
+  uint16_t mode = td_window_list[data];
+  if(b) {
+    b->icon = (props_mode & (TD_WINDOW|TD_WINDOW_TYPE)) == mode ? BUTTON_ICON_GROUP_CHECKED : BUTTON_ICON_GROUP;
+    b->p1.text = get_td_window_name(mode);
+    return;
+  }
+  props_mode = (props_mode & ~(TD_WINDOW|TD_WINDOW_TYPE)) | mode;
+}
+
+#ifdef __USE_FFT_SIZE_SELECT__
+static UI_FUNCTION_ADV_CALLBACK(menu_transform_fft_size_acb) {
+  (void)data;
+  uint16_t size = td_fft_size();
+  if(b) {
+    b->p1.u = size;
+    return;
+  }
+  set_timedomain_fft_size(size < FFT_SIZE_MAX ? size * 2 : FFT_SIZE);
+}
+#endif
+
+#ifdef __USE_TD_GATE__
+static UI_FUNCTION_ADV_CALLBACK(menu_transform_gate_acb) {
+  (void)data;
   if(b) {
-    b->p1.text = text;
+    b->icon = (props_mode & TD_GATE) ? BUTTON_ICON_CHECK : BUTTON_ICON_NOCHECK;
     return;
   }
-  props_mode = (props_mode & ~TD_WINDOW) | data;
+  props_mode ^= TD_GATE;
+  request_to_redraw(REDRAW_CAL_STATUS);
 }
+#endif
+
+#ifdef __USE_PORT_EXTENSION__
+static UI_FUNCTION_CALLBACK(menu_portext_cb) {
+#ifdef __USE_PORT_EXTENSION_AUTO__
+  if (data) {port_extension_auto(); return;}
+#endif
+  (void)data;
+  set_port_extension(0.0f, 0.0f, 0.0f, 0);
+}
+#endif
 
 static UI_FUNCTION_ADV_CALLBACK(menu_transform_acb) {
   (void)data;
@@ -1101,6 +1166,35 @@ static UI_FUNCTION_ADV_CALLBACK(menu_smooth_acb) {
   }
   set_smooth_factor(data);
 }
+
+static UI_FUNCTION_ADV_CALLBACK(menu_smooth_median_acb) {
+  (void)data;
+  if (b) {
+    b->icon = get_smooth_median() ? BUTTON_ICON_CHECK : BUTTON_ICON_NOCHECK;
+    return;
+  }
+  set_smooth_median(!get_smooth_median());
+}
+#endif
+
+#ifdef __USE_AVERAGE__
+static UI_FUNCTION_ADV_CALLBACK(menu_average_acb) {
+  if (b) {
+    b->icon = get_average_count() == data ? BUTTON_ICON_GROUP_CHECKED : BUTTON_ICON_GROUP;
+    b->p1.u = data;
+    return;
+  }
+  set_average(data, get_average_mode());
+}
+
+static UI_FUNCTION_ADV_CALLBACK(menu_average_mode_acb) {
+  (void)data;
+  if (b) {
+    b->p1.text = get_average_mode() == AVERAGE_EXP ? "EXP" : "BLOCK";
+    return;
+  }
+  set_average(get_average_count(), get_average_mode() == AVERAGE_EXP ? AVERAGE_BLOCK : AVERAGE_EXP);
+}
 #endif
 
 const menuitem_t menu_sweep_points[];
@@ -2158,6 +2252,20 @@ const menuitem_t menu_formatS11[] = {
   { MT_NEXT, 0, NULL, menu_back } // next-> menu_back
 };
 
+#ifdef __USE_PORT_EXTENSION__
+const menuitem_t menu_portext[] = {
+  { MT_ADV_CALLBACK, KM_PORTEXT_DELAY, "DELAY",     menu_keyboard_acb },
+  { MT_ADV_CALLBACK, KM_PORTEXT_LOSS0, "LOSS DC",   menu_keyboard_acb },
+  { MT_ADV_CALLBACK, KM_PORTEXT_LOSS1, "LOSS",      menu_keyboard_acb },
+  { MT_ADV_CALLBACK, KM_PORTEXT_FREQ,  "LOSS FREQ", menu_keyboard_acb },
+#ifdef __USE_PORT_EXTENSION_AUTO__
+  { MT_CALLBACK,     1,                "AUTO\n(OPEN/SHORT)", menu_portext_cb },
+#endif
+  { MT_CALLBACK,     0,                "RESET",     menu_portext_cb },
+  { MT_NEXT, 0, NULL, menu_back } // next-> menu_back
+};
+#endif
+
 const menuitem_t menu_scale[] = {
   { MT_ADV_CALLBACK, 0,            "TRACE",               menu_atrace_acb },
   { MT_CALLBACK,     0,            "AUTO SCALE",          menu_auto_scale_cb },
@@ -2167,6 +2275,9 @@ const menuitem_t menu_scale[] = {
   { MT_ADV_CALLBACK, KM_REFPOS,    "REF POSITION",        menu_scale_keyboard_acb },
   { MT_ADV_CALLBACK, KM_EDELAY,    "E-DELAY",             menu_keyboard_acb },
   { MT_ADV_CALLBACK, KM_S21OFFSET, "S21 OFFSET\n " R_LINK_COLOR "%b.3F" S_dB,  menu_keyboard_acb },
+#ifdef __USE_PORT_EXTENSION__
+  { MT_SUBMENU,      0,            "PORT EXT",            menu_portext },
+#endif
 #ifdef __USE_GRID_VALUES__
   { MT_ADV_CALLBACK, VNA_MODE_SHOW_GRID, "SHOW GRID\nVALUES", menu_vna_mode_acb },
   { MT_ADV_CALLBACK, VNA_MODE_DOT_GRID , "DOT GRID",          menu_vna_mode_acb },
@@ -2174,12 +2285,42 @@ const menuitem_t menu_scale[] = {
   { MT_NEXT, 0, NULL, menu_back } // next-> menu_back
 };
 
+#ifdef __USE_TD_GATE__
+const menuitem_t menu_transform_gate[] = {
+  { MT_ADV_CALLBACK, 0,                 "GATE",      menu_transform_gate_acb },
+  { MT_ADV_CALLBACK, KM_TD_GATE_CENTER, "CENTER",    menu_keyboard_acb },
+  { MT_ADV_CALLBACK, KM_TD_GATE_SPAN,   "SPAN",      menu_keyboard_acb },
+  { MT_NEXT, 0, NULL, menu_back } // next-> menu_back
+};
+#endif
+
+const menuitem_t menu_transform_window[] = {
+  { MT_ADV_CALLBACK, 0, "%s", menu_transform_window_sel_acb },
+  { MT_ADV_CALLBACK, 1, "%s", menu_transform_window_sel_acb },
+  { MT_ADV_CALLBACK, 2, "%s", menu_transform_window_sel_acb },
+  { MT_ADV_CALLBACK, 3, "%s", menu_transform_window_sel_acb },
+  { MT_ADV_CALLBACK, 4, "%s", menu_transform_window_sel_acb },
+  { MT_ADV_CALLBACK, 5, "%s", menu_transform_window_sel_acb },
+  { MT_ADV_CALLBACK, KM_TD_BETA, "KAISER BETA\n " R_LINK_COLOR "%d", menu_keyboard_acb },
+  { MT_NEXT, 0, NULL, menu_back } // next-> menu_back
+};
+
 const menuitem_t menu_transform[] = {
   { MT_ADV_CALLBACK, 0,                       "TRANSFORM\n%s",      menu_transform_acb },
   { MT_ADV_CALLBACK, TD_FUNC_LOWPASS_IMPULSE, "LOW PASS\nIMPULSE",  menu_transform_filter_acb },
   { MT_ADV_CALLBACK, TD_FUNC_LOWPASS_STEP,    "LOW PASS\nSTEP",     menu_transform_filter_acb },
   { MT_ADV_CALLBACK, TD_FUNC_BANDPASS,        "BANDPASS",           menu_transform_filter_acb },
   { MT_ADV_CALLBACK, 0,                       "WINDOW\n " R_LINK_COLOR "%s", menu_transform_window_acb },
+#ifdef __USE_TD_ZOOM__
+  { MT_ADV_CALLBACK, KM_TD_ZOOM_START,        "ZOOM START",         menu_keyboard_acb },
+  { MT_ADV_CALLBACK, KM_TD_ZOOM_STOP,         "ZOOM STOP",          menu_keyboard_acb },
+#endif
+#ifdef __USE_TD_GATE__
+  { MT_SUBMENU,      0,                       "GATE",               menu_transform_gate },
+#endif
+#ifdef __USE_FFT_SIZE_SELECT__
+  { MT_ADV_CALLBACK, 0,                       "FFT SIZE\n " R_LINK_COLOR "%u", menu_transform_fft_size_acb },
+#endif
   { MT_ADV_CALLBACK, KM_VELOCITY_FACTOR,      "VELOCITY F.\n " R_LINK_COLOR "%d%%%%", menu_keyboard_acb },
   { MT_NEXT, 0, NULL, menu_back } // next-> menu_back
 };
@@ -2215,6 +2356,7 @@ const menuitem_t menu_bandwidth[] = {
 #ifdef __USE_SMOOTH__
 const menuitem_t menu_smooth_count[] = {
   { MT_ADV_CALLBACK, VNA_MODE_SMOOTH, "SMOOTH\n " R_LINK_COLOR "%s avg",menu_vna_mode_acb },
+  { MT_ADV_CALLBACK, 0, "MEDIAN",menu_smooth_median_acb },
   { MT_ADV_CALLBACK, 0, "SMOOTH\nOFF",menu_smooth_acb },
   { MT_ADV_CALLBACK, 1, "x%d", menu_smooth_acb },
   { MT_ADV_CALLBACK, 2, "x%d", menu_smooth_acb },
@@ -2225,6 +2367,19 @@ const menuitem_t menu_smooth_count[] = {
 };
 #endif
 
+#ifdef __USE_AVERAGE__
+const menuitem_t menu_average_count[] = {
+  { MT_ADV_CALLBACK, 0, "AVERAGE\n " R_LINK_COLOR "%s",menu_average_mode_acb },
+  { MT_ADV_CALLBACK, 0, "AVERAGE\nOFF",menu_average_acb },
+  { MT_ADV_CALLBACK, 2, "x%d", menu_average_acb },
+  { MT_ADV_CALLBACK, 4, "x%d", menu_average_acb },
+  { MT_ADV_CALLBACK, 8, "x%d", menu_average_acb },
+  { MT_ADV_CALLBACK,16, "x%d", menu_average_acb },
+  { MT_ADV_CALLBACK,32, "x%d", menu_average_acb },
+  { MT_NEXT, 0, NULL, menu_back } // next-> menu_back
+};
+#endif
+
 const menuitem_t menu_display[] = {
   { MT_ADV_CALLBACK, 0, "TRACE",                               menu_traces_acb },
   { MT_SUBMENU,      0, "FORMAT\n S11 (REFL)",                 menu_formatS11 },
@@ -2236,8 +2391,12 @@ const menuitem_t menu_display[] = {
 #ifdef __USE_SMOOTH__
   { MT_SUBMENU,      0, "DATA SMOOTH",                         menu_smooth_count },
 #endif
+#ifdef __USE_AVERAGE__
+  { MT_SUBMENU,      0, "AVERAGE",                             menu_average_count },
+#endif
 #ifdef __VNA_Z_RENORMALIZATION__
   { MT_ADV_CALLBACK, KM_Z_PORT, "PORT-Z\n " R_LINK_COLOR "50 " S_RARROW " %bF" S_OHM, menu_keyboard_acb},
+  { MT_ADV_CALLBACK, KM_Z_PORT_X, "PORT-Z jX\n " R_LINK_COLOR "%bF" S_OHM, menu_keyboard_acb},
 #endif
   { MT_NEXT, 0, NULL, menu_back } // next-> menu_back
 };
@@ -3086,6 +3245,61 @@ UI_KEYBOARD_CALLBACK(input_velocity) {
   velocity_factor = keyboard_get_uint();
 }
 
+UI_KEYBOARD_CALLBACK(input_td_beta) {
+  (void)data;
+  if (b) {b->p1.u = td_beta; return;}
+  set_timedomain_beta(keyboard_get_uint());
+}
+
+#ifdef __USE_TD_ZOOM__
+UI_KEYBOARD_CALLBACK(input_td_zoom) {
+  if (b) {
+    plot_printf(b->label, sizeof(b->label), "%s\n " R_LINK_COLOR "%.4F" S_SECOND, data ? "ZOOM STOP" : "ZOOM START", current_props._td_zoom[data]);
+    return;
+  }
+  float t = keyboard_get_float();
+  if (data) set_timedomain_zoom(td_zoom_start, t);
+  else      set_timedomain_zoom(t, td_zoom_stop);
+}
+#endif
+
+#ifdef __USE_TD_GATE__
+UI_KEYBOARD_CALLBACK(input_td_gate) {
+  if (b) {
+    plot_printf(b->label, sizeof(b->label), "%s\n " R_LINK_COLOR "%.4F" S_SECOND, data ? "SPAN" : "CENTER", current_props._td_gate[data]);
+    return;
+  }
+  float t = keyboard_get_float();
+  if (data) set_timedomain_gate(td_gate_center, t);
+  else      set_timedomain_gate(t, td_gate_span);
+}
+#endif
+
+#ifdef __USE_PORT_EXTENSION__
+UI_KEYBOARD_CALLBACK(input_portext) {
+  float delay = portext_delay;
+  float loss0 = portext_loss[0] * PORTEXT_LOSS_UNIT;
+  float loss1 = portext_loss[1] * PORTEXT_LOSS_UNIT;
+  freq_t freq = portext_freq;
+  if (b) {
+    switch (data) {
+      case 0: plot_printf(b->label, sizeof(b->label), "DELAY\n " R_LINK_COLOR "%.4F" S_SECOND, delay); break;
+      case 1: plot_printf(b->label, sizeof(b->label), "LOSS DC\n " R_LINK_COLOR "%.3F" S_dB, loss0); break;
+      case 2: plot_printf(b->label, sizeof(b->label), "LOSS\n " R_LINK_COLOR "%.3F" S_dB, loss1); break;
+      default:plot_printf(b->label, sizeof(b->label), "LOSS FREQ\n " R_LINK_COLOR "%.3q" S_Hz, freq); break;
+    }
+    return;
+  }
+  switch (data) {
+    case 0: delay = keyboard_get_float(); break;
+    case 1: loss0 = keyboard_get_float(); break;
+    case 2: loss1 = keyboard_get_float(); break;
+    default:freq  = keyboard_get_freq();  break;
+  }
+  set_port_extension(delay, loss0, loss1, freq);
+}
+#endif
+
 #ifdef __S11_CABLE_MEASURE__
 extern float real_cable_len;
 UI_KEYBOARD_CALLBACK(input_cable_len) {
@@ -3127,9 +3341,9 @@ UI_KEYBOARD_CALLBACK(input_measure_r) {
 
 #ifdef __VNA_Z_RENORMALIZATION__
 UI_KEYBOARD_CALLBACK(input_portz) {
-  if (b) {b->p1.f = data ? current_props._cal_load_r : current_props._portz; return;}
-  if (data) current_props._cal_load_r = keyboard_get_float();
-  else      current_props._portz = keyboard_get_float();
+  float *v = data == 0 ? &current_props._portz : data == 1 ? &current_props._cal_load_r : &current_props._portz_x;
+  if (b) {b->p1.f = *v; return;}
+  *v = keyboard_get_float();
 }
 #endif
 
@@ -3209,6 +3423,21 @@ const keypads_list keypads_mode_tbl[KM_NONE] = {
 [KM_VAR_DELAY]       = {KEYPAD_NFLOAT, 0,             "JOG STEP",           input_var_delay}, // VAR electrical delay
 [KM_S21OFFSET]       = {KEYPAD_FLOAT,  0,             "S21 OFFSET",         input_s21_offset},// S21 level offset
 [KM_VELOCITY_FACTOR] = {KEYPAD_PERCENT,0,             "VELOCITY%%",         input_velocity }, // velocity factor
+[KM_TD_BETA]         = {KEYPAD_UFLOAT, 0,             "KAISER BETA",        input_td_beta  }, // user Kaiser window beta
+#ifdef __USE_TD_ZOOM__
+[KM_TD_ZOOM_START]   = {KEYPAD_NFLOAT, 0,             "ZOOM START",         input_td_zoom  }, // time domain zoom start
+[KM_TD_ZOOM_STOP]    = {KEYPAD_NFLOAT, 1,             "ZOOM STOP",          input_td_zoom  }, // time domain zoom stop
+#endif
+#ifdef __USE_TD_GATE__
+[KM_TD_GATE_CENTER]  = {KEYPAD_NFLOAT, 0,             "GATE CENTER",        input_td_gate  }, // time domain gate center
+[KM_TD_GATE_SPAN]    = {KEYPAD_NFLOAT, 1,             "GATE SPAN",          input_td_gate  }, // time domain gate span
+#endif
+#ifdef __USE_PORT_EXTENSION__
+[KM_PORTEXT_DELAY]   = {KEYPAD_NFLOAT, 0,             "PORT EXT DELAY",     input_portext  }, // port extension delay
+[KM_PORTEXT_LOSS0]   = {KEYPAD_FLOAT,  1,             "LOSS AT DC",         input_portext  }, // port extension loss at DC
+[KM_PORTEXT_LOSS1]   = {KEYPAD_FLOAT,  2,             "LOSS AT FREQ",       input_portext  }, // port extension loss at reference frequency
+[KM_PORTEXT_FREQ]    = {KEYPAD_FREQ,   3,             "LOSS FREQ",          input_portext  }, // port extension loss reference frequency
+#endif
 #ifdef __S11_CABLE_MEASURE__
 [KM_ACTUAL_CABLE_LEN]= {KEYPAD_MKUFLOAT,0,            "CABLE LENGTH",       input_cable_len}, // real cable length input for VF calculation
 #endif
@@ -3220,6 +3449,7 @@ const keypads_list keypads_mode_tbl[KM_NONE] = {
 #endif
 #ifdef __VNA_Z_RENORMALIZATION__
 [KM_Z_PORT]          = {KEYPAD_UFLOAT, 0,             "PORT Z 50" S_RARROW, input_portz    }, // Port Z renormalization impedance
+[KM_Z_PORT_X]        = {KEYPAD_FLOAT,  2,             "PORT Z jX",          input_portz    }, // Port Z renormalization reactance
 [KM_CAL_LOAD_R]      = {KEYPAD_UFLOAT, 1,             "STANDARD\n LOAD R",  input_portz    }, // Calibration standard load R
 #endif
 #ifdef __USE_RTC__
@@ -3308,7 +3538,7 @@ static void draw_numeric_input(const char *buf) {
   uint16_t y = LCD_HEIGHT-(NUM_FONT_GET_HEIGHT+NUM_INPUT_HEIGHT)/2;
   uint32_t xsim;
 #ifdef __USE_RTC__
-  if ((1<<keypad_mode)&((1<<KM_RTC_DATE)|(1<<KM_RTC_TIME)))
+  if (keypad_mode == KM_RTC_DATE || keypad_mode == KM_RTC_TIME)
     xsim = 0b01010100;
   else
 #endif
@@ -3372,7 +3602,7 @@ static int num_keypad_click(int c, int kp_index) {
     return K_DONE;
   }
 #ifdef __USE_RTC__
-  int maxlength = (1<<keypad_mode)&((1<<KM_RTC_DATE)|(1<<KM_RTC_TIME)) ? 6 : NUMINPUT_LEN;
+  int maxlength = (keypad_mode == KM_RTC_DATE || keypad_mode == KM_RTC_TIME) ? 6 : NUMINPUT_LEN;
 #else
   int maxlength = NUMINPUT_LEN;
 #endif
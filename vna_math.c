@@ -166,23 +166,28 @@ const float sin_table_256[256/4 + 1] = {
 // Define SIN table used in FFT and in sin/cos calculations
 // full table size = 1<<SIN_TABLE_N, but in calculations use only first sector
 //         !!! FFT_N must be <= SIN_TABLE_N !!!
-// FFT_SIZE = 1 << FFT_N
-#if   FFT_SIZE == 256 // Use bigger SIN table, provide less error in sin/cos calculations
-#define SIN_TABLE   sin_table_512
-#define SIN_TABLE_N  9
+// FFT_SIZE = 1 << FFT_N, SIN table selected for max FFT size (runtime FFT size can be up to FFT_SIZE_MAX)
+#if   FFT_SIZE == 256
 #define FFT_N        8
 #elif FFT_SIZE == 512
-#define SIN_TABLE   sin_table_512
-#define SIN_TABLE_N  9
 #define FFT_N        9
 #elif FFT_SIZE == 1024
-#define SIN_TABLE   sin_table_1024
-#define SIN_TABLE_N 10
 #define FFT_N       10
 #elif FFT_SIZE == 2048
+#define FFT_N       11
+#else
+#error "Need build table for new FFT size"
+#endif
+
+#if   FFT_SIZE_MAX <= 512 // Use bigger SIN table for 256, provide less error in sin/cos calculations
+#define SIN_TABLE   sin_table_512
+#define SIN_TABLE_N  9
+#elif FFT_SIZE_MAX == 1024
+#define SIN_TABLE   sin_table_1024
+#define SIN_TABLE_N 10
+#elif FFT_SIZE_MAX == 2048
 #define SIN_TABLE   sin_table_2048
 #define SIN_TABLE_N 11
-#define FFT_N       11
 #else
 #error "Need build table for new FFT size"
 #endif
@@ -208,7 +213,7 @@ static uint32_t reverse_bits(uint32_t x, int n) { // up to 16 bit
 }
 #elif 1 // Use table
 static uint16_t reverse_bits(uint16_t x, int n) { // up to 12 bit
-  static const uint8_t rev_nibble[16] = {0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x3, 0xB, 0x5, 0xD, 0x7, 0xF};
+  static const uint8_t rev_nibble[16] = {0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF};
   x = (rev_nibble[(x >>  0) & 0xF] << 8) |
       (rev_nibble[(x >>  4) & 0xF] << 4) |
       (rev_nibble[(x >>  8) & 0xF] << 0);
@@ -224,51 +229,158 @@ static uint16_t reverse_bits(uint16_t x, int n) {
 }
 #endif
 
-// Cooley-Tukey radix-2 DIT FFT, dir = 0:forward, 1:inverse
-void fft(float array[][2], const uint8_t dir) {
-  uint16_t fft_n    = FFT_N;     // can be in range 1 <= fft_n <= SIN_TABLE_N
+// Return sin/cos for SIN table index (index in range 0 ... (1<<SIN_TABLE_N)/2, angle 0 ... 180 degree)
+// Use SIN table (only first period), table size (1<<SIN_TABLE_N)/4
+static inline void fft_sincos(uint32_t table_index, float *s, float *c) {
+  const uint32_t SIN_TABLE_SUB = SIN_TABLE_N - 2;               // SIN table one sector N (full table must contain 4 sectors)
+  const uint32_t sector = table_index >> SIN_TABLE_SUB;
+  const uint32_t sidx = table_index & ((1<<SIN_TABLE_SUB) - 1); // sin value index
+  const uint32_t cidx = (1<<SIN_TABLE_SUB) - sidx;              // cos value index
+  const float sin = SIN_TABLE[sidx];
+  const float cos = SIN_TABLE[cidx];
+  *s = sector & 1 ?  cos : sin;                                 // Fix digit and values for 90 ... 180 degree
+  *c = sector & 1 ? -sin : cos;
+}
+
+// Complex multiply on twiddle factor: r = v * (c + j*s)
+#define FFT_CMUL(r, v, c, s) { \
+  r[0] = vna_fmaf(v[0], c,-v[1] * s); \
+  r[1] = vna_fmaf(v[0], s, v[1] * c); \
+}
+
+// Cooley-Tukey DIT FFT, dir = 0:forward, 1:inverse, size = 1<<fft_n (1 <= fft_n <= SIN_TABLE_N)
+// Two radix-2 stages joined in one radix-4 like pass (radix-2^2), less data load/store and twiddle calculations
+// Allow made FFT for count arrays placed one after another, all use same twiddle factors
+static void fft_batch(float array[][2], const uint16_t fft_n, const uint8_t dir, const uint16_t count) {
   uint16_t fft_size = 1<<fft_n;  // data size = 1<<fft_n
-  uint16_t i, j, k, l;
-  for (i = 0; i < fft_size; i++) {
-    if ((j = reverse_bits(i, fft_n)) > i) {
-      SWAP(float, array[i][0], array[j][0]);
-      SWAP(float, array[i][1], array[j][1]);
+  uint16_t total = fft_size * count;
+  uint16_t i, j, k, n;
+  for (n = 0; n < total; n+= fft_size) {
+    for (i = 0; i < fft_size; i++) {
+      if ((j = reverse_bits(i, fft_n)) > i) {
+        SWAP(float, array[n + i][0], array[n + j][0]);
+        SWAP(float, array[n + i][1], array[n + j][1]);
+      }
     }
   }
-  // Optimized Cooley-Tukey decimation-in-time radix-2 FFT
-  // Use SIN table (only first period), table size (1<<SIN_TABLE_N)/4
   uint16_t size = 1;
   uint16_t tablestep = (1<<SIN_TABLE_N) / 2;
-  for (;size < fft_size; tablestep>>=1, size<<=1) {
-    for (i = 0; i < size; i++) {
-      uint32_t table_index = i * tablestep;
-      const uint32_t SIN_TABLE_SUB = SIN_TABLE_N - 2;               // SIN table one sector N (full table must contain 4 sectors)
-      const uint32_t sector = table_index >> SIN_TABLE_SUB;
-      const uint32_t sidx = table_index & ((1<<SIN_TABLE_SUB) - 1); // sin value index
-      const uint32_t cidx = (1<<SIN_TABLE_SUB) - sidx;              // cos value index
-      const float sin = SIN_TABLE[sidx];
-      const float cos = SIN_TABLE[cidx];
-      float s = sector & 1 ?  cos : sin;                            // Fix digit and values for 90 ... 180 degree
-      float c = sector & 1 ? -sin : cos;
-      if (!dir) s= -s;
-      for (k = i; k < fft_size; k = l + size) {
-        l = k + size;
-#if 0
-        float tpre = array[l][0] * c - array[l][1] * s;
-        float tpim = array[l][0] * s + array[l][1] * c;
-        array[l][0] = array[k][0] - tpre; array[k][0] += tpre;
-        array[l][1] = array[k][1] - tpim; array[k][1] += tpim;
-#else
-        float tpre = vna_fmaf(array[l][0], c,-array[l][1] * s);
-        float tpim = vna_fmaf(array[l][0], s, array[l][1] * c);
-        array[l][0] = array[k][0] - tpre; array[k][0] += tpre;
-        array[l][1] = array[k][1] - tpim; array[k][1] += tpim;
-#endif
+  // For odd stages count made first radix-2 stage (twiddle = 1)
+  if (fft_n & 1) {
+    for (k = 0; k < total; k+=2) {
+      float re = array[k+1][0], im = array[k+1][1];
+      array[k+1][0] = array[k][0] - re; array[k][0]+= re;
+      array[k+1][1] = array[k][1] - im; array[k][1]+= im;
+    }
+    tablestep>>=1; size<<=1;
+  }
+  // Radix-2^2 passes: stage with half size m and twiddle W1, next stage with half size 2m and twiddles W2, W2 * (-+j)
+  for (;size < fft_size; tablestep>>=2, size<<=2) {
+    const uint16_t m = size;
+    for (i = 0; i < m; i++) {
+      float s1, c1, s2, c2;
+      fft_sincos(i * tablestep, &s1, &c1);
+      fft_sincos(i * tablestep / 2, &s2, &c2);
+      if (!dir) {s1 = -s1; s2 = -s2;}
+      for (k = i; k < total; k+= 4*m) {
+        float *a = array[k], *b = array[k + m], *c = array[k + 2*m], *d = array[k + 3*m];
+        float t0[2], t1[2], b1[2], d1[2];
+        // First stage
+        FFT_CMUL(t0, b, c1, s1);
+        FFT_CMUL(t1, d, c1, s1);
+        float a1[2] = {a[0] + t0[0], a[1] + t0[1]};
+        float b2[2] = {a[0] - t0[0], a[1] - t0[1]};
+        float c3[2] = {c[0] + t1[0], c[1] + t1[1]};
+        float d2[2] = {c[0] - t1[0], c[1] - t1[1]};
+        // Second stage
+        FFT_CMUL(b1, c3, c2, s2);
+        FFT_CMUL(t1, d2, c2, s2);
+        if (dir) {d1[0] =-t1[1]; d1[1] = t1[0];} // * (+j) for inverse
+        else     {d1[0] = t1[1]; d1[1] =-t1[0];} // * (-j) for forward
+        a[0] = a1[0] + b1[0]; a[1] = a1[1] + b1[1];
+        c[0] = a1[0] - b1[0]; c[1] = a1[1] - b1[1];
+        b[0] = b2[0] + d1[0]; b[1] = b2[1] + d1[1];
+        d[0] = b2[0] - d1[0]; d[1] = b2[1] - d1[1];
       }
     }
   }
 }
 
+// Return n for FFT size = 1<<n
+static uint16_t fft_size_n(uint16_t fft_size) {
+  uint16_t n = 0;
+  while ((1<<n) < fft_size) n++;
+  return n;
+}
+
+// FFT for any size = 2^n (up to 1<<SIN_TABLE_N)
+void fft_ex(float array[][2], const uint16_t fft_size, const uint8_t dir) {
+  fft_batch(array, fft_size_n(fft_size), dir, 1);
+}
+
+void fft(float array[][2], const uint8_t dir) {
+  fft_batch(array, FFT_N, dir, 1);
+}
+
+// Inverse FFT for Hermitian spectrum (real output), made by complex iFFT of half size
+// Input:  count arrays of fft_size/2 spectrum points X[k] placed one after another (X[fft_size - k] = conj(X[k]))
+//         imaginary part of X[0] and X[fft_size/2] not used, so real part of X[fft_size/2] packed in array[0][1]
+// Output: fft_size real values x[n] for every array packed as float ((float *)array)[n]
+void fft_inverse_real(float array[][2], const uint16_t fft_size, const uint16_t count) {
+  const uint16_t M = fft_size / 2;
+  uint16_t k, n;
+  // Z[k] = Xe[k] + j*Xo[k], Xe[k] = X[k] + conj(X[M-k]), Xo[k] = (X[k] - conj(X[M-k])) * exp(j*2*pi*k/N)
+  // Xe[M-k] = conj(Xe[k]), Xo[M-k] = conj(Xo[k])
+  for (n = 0; n < M * count; n+= M) {
+    float x0 = array[n][0], xm = array[n][1];
+    array[n][0] = x0 + xm;
+    array[n][1] = x0 - xm;
+  }
+  for (k = 1; k <= M/2; k++) {
+    float s, c;
+    fft_sincos(k * ((1<<SIN_TABLE_N) / fft_size), &s, &c);
+    for (n = 0; n < M * count; n+= M) {
+      float *p = array[n + k], *q = array[n + M - k];
+      float e[2] = {p[0] + q[0], p[1] - q[1]}; // Xe[k]
+      float d[2] = {p[0] - q[0], p[1] + q[1]}; // X[k] - conj(X[M-k])
+      float o[2];
+      FFT_CMUL(o, d, c, s);                    // Xo[k]
+      // Z[k] = Xe + j*Xo, Z[M-k] = conj(Xe) + j*conj(Xo)
+      p[0] = e[0] - o[1]; p[1] = e[1] + o[0];
+      q[0] = e[0] + o[1]; q[1] = o[0] - e[1];
+    }
+  }
+  fft_batch(array, fft_size_n(M), 1, count);
+  // z[n] = x[2n] + j*x[2n+1], so output already packed in array
+}
+
+#if FFT_SIZE_MAX > FFT_SIZE
+// Inverse FFT of size fft_size = R * FFT_SIZE (up to FFT_SIZE_MAX) for input X[k] not zero only for k < points <= FFT_SIZE,
+// calculate only out_points first outputs, need only FFT_SIZE work buffer:
+// x[R*m + r] = sum(X[k] * w^(k*(R*m + r))) = iFFT(X[k] * w^(k*r))[m], w = exp(j*2*pi/fft_size), m = 0 ... FFT_SIZE-1
+void fft_inverse_pruned(const float in[][2], uint16_t points, float out[][2], uint16_t out_points, uint16_t fft_size, float work[][2]) {
+  const uint16_t R = fft_size / FFT_SIZE;
+  const uint32_t step = (1<<SIN_TABLE_N) / fft_size, half = (1<<SIN_TABLE_N) / 2;
+  uint16_t k, r, m;
+  for (r = 0; r < R && r < out_points; r++) {
+    for (k = 0; k < points; k++) {
+      float s, c;
+      uint32_t idx = (k * r * step) & (2 * half - 1);
+      if (idx < half) fft_sincos(idx, &s, &c);
+      else {fft_sincos(idx - half, &s, &c); s = -s; c = -c;}
+      FFT_CMUL(work[k], in[k], c, s);
+    }
+    for (; k < FFT_SIZE; k++)
+      work[k][0] = work[k][1] = 0.0f;
+    fft_batch(work, FFT_N, 1, 1);
+    for (m = 0; R * m + r < out_points; m++) {
+      out[R * m + r][0] = work[m][0];
+      out[R * m + r][1] = work[m][1];
+    }
+  }
+}
+#endif
+
 // Return sin/cos value angle in range 0.0 to 1.0 (0 is 0 degree, 1 is 360 degree)
 void vna_sincosf(float angle, float * pSinVal, float * pCosVal) {
 #ifndef __VNA_USE_MATH_TABLES__
@@ -302,6 +414,34 @@ void vna_sincosf(float angle, float * pSinVal, float * pCosVal) {
 #endif
 }
 
+// IEEE 754 half float (binary16) pack, rounding by add rnd bits before truncate (rnd = 0 - truncate,
+// random value - stochastic rounding, not biased on accumulate), too big values saturated, no inf/NaN
+uint16_t vna_f2h(float v, uint32_t rnd) {
+  union {float f; uint32_t i;} u = {v};
+  uint16_t s = (u.i >> 16) & 0x8000;
+  int32_t  e = (int32_t)((u.i >> 23) & 0xFF) - 127 + 15;
+  uint32_t m = (u.i & 0x7FFFFF) | 0x800000;
+  if (e <= 0) {                            // denormal: m * 2^-24
+    uint32_t shift = 14 - e;
+    if (shift > 31) return s;
+    return s | ((m + (rnd & ((1U << shift) - 1))) >> shift); // overflow to 0x400 give min normal value
+  }
+  m+= rnd & 0x1FFF;
+  if (m & 0x1000000) {m>>= 1; e++;}
+  if (e >= 31) return s | 0x7BFF;
+  return s | (e << 10) | ((m >> 13) & 0x3FF);
+}
+
+float vna_h2f(uint16_t h) {
+  uint32_t e = (h >> 10) & 0x1F;
+  if (e == 0) {                            // denormal
+    float v = (h & 0x3FF) * (1.0f / (1 << 24));
+    return h & 0x8000 ? -v : v;
+  }
+  union {uint32_t i; float f;} u = {((uint32_t)(h & 0x8000) << 16) | ((e + 127 - 15) << 23) | ((uint32_t)(h & 0x3FF) << 13)};
+  return u.f;
+}
+
 //**********************************************************************************
 //      VNA math
 //**********************************************************************************
@@ -80,11 +80,18 @@ float vna_modff(float x, float *iptr);
 #endif
 
 // fft
+void fft_ex(float array[][2], const uint16_t fft_size, const uint8_t dir);
 void fft(float array[][2], const uint8_t dir);
+void fft_inverse_real(float array[][2], const uint16_t fft_size, const uint16_t count);
+void fft_inverse_pruned(const float in[][2], uint16_t points, float out[][2], uint16_t out_points, uint16_t fft_size, float work[][2]);
 #define fft_forward(array) fft(array, 0)
 #define fft_inverse(array) fft(array, 1)
 
 // Return sin/cos value, angle have range 0.0 to 1.0 (0 is 0 degree, 1 is 360 degree)
 void vna_sincosf(float angle, float * pSinVal, float * pCosVal);
 
+// Half float (binary16) pack/unpack, rnd - random value for stochastic rounding
+uint16_t vna_f2h(float v, uint32_t rnd);
+float    vna_h2f(uint16_t h);
+
 #endif
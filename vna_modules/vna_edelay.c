@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2019-2026, Dmitry (DiSlord) dislordlive@gmail.com
+ * All rights reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * The software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+//=====================================================================================================
+// Electrical delay on linear sweep: frequency step between points is df or df + 1 Hz (integer rounding),
+// so rotate phasor on one of two precalculated steps instead of sin/cos calculation for every point.
+// Any other frequency change (sweep restart, skipped points) and every EDELAY_RESYNC points phasor resync
+//=====================================================================================================
+#define EDELAY_RESYNC  16
+// Rotator for e-delay on S11, S21 (ch 0, 1) and port extension delay on S11, S21 (ch 2, 3)
+#define EDELAY_ROT_PORTEXT  2
+static freq_t edelay_df;        // sweep frequency step (set on sweep start)
+static struct {
+  float  delay;
+  freq_t df;
+  freq_t freq;                  // phasor frequency
+  float  re, im;                // phasor
+  float  step[2][2];            // phase step on df and df + 1 Hz (re, im)
+  uint8_t count;                // steps left before resync
+} edelay_rot[4];
+
+// Precise sin/cos for angle in turns (-1.0 < t < 1.0) used for phasor seed and step
+// Reduce to -pi/4 ... pi/4 and use Taylor polynomial, max error ~1e-7
+static void edelay_sincos(float t, float *ps, float *pc) {
+  int q = t * 4.0f + (t < 0.0f ? -0.5f : 0.5f);  // nearest quadrant
+  float x = (t - q * 0.25f) * (2.0f * VNA_PI);
+  float x2 = x * x;
+  float s = x * (1.0f - x2 * (1.0f/6.0f - x2 * (1.0f/120.0f - x2 * (1.0f/5040.0f))));
+  float c = 1.0f - x2 * (0.5f - x2 * (1.0f/24.0f - x2 * (1.0f/720.0f - x2 * (1.0f/40320.0f))));
+  switch (q & 3) {
+    case 0: *ps = s; *pc = c; break;
+    case 1: *ps = c; *pc =-s; break;
+    case 2: *ps =-s; *pc =-c; break;
+    case 3: *ps =-c; *pc = s; break;
+  }
+}
+
+static void applyEDelayPoint(int ch, float delay, freq_t frequency, float data[2]) {
+  float s, c;
+  if (edelay_rot[ch].delay != delay || edelay_rot[ch].df != edelay_df) {
+    edelay_rot[ch].delay = delay;
+    edelay_rot[ch].df    = edelay_df;
+    edelay_rot[ch].count = 0;
+    for (int i = 0; i < 2; i++) {
+      double w = (double)delay * (edelay_df + i);
+      edelay_sincos(w - (int64_t)w, &edelay_rot[ch].step[i][1], &edelay_rot[ch].step[i][0]);
+    }
+  }
+  freq_t d = frequency - edelay_rot[ch].freq - edelay_df;
+  if (edelay_rot[ch].count && d <= 1) {
+    // Rotate phasor on step
+    const float *step = edelay_rot[ch].step[d];
+    s = edelay_rot[ch].im;
+    c = edelay_rot[ch].re;
+    edelay_rot[ch].re = c * step[0] - s * step[1];
+    edelay_rot[ch].im = s * step[0] + c * step[1];
+    edelay_rot[ch].count--;
+  } else {
+    // Phase in turns can be big, use double for get precise fractional part
+    double w = (double)delay * frequency;
+    edelay_sincos(w - (int64_t)w, &edelay_rot[ch].im, &edelay_rot[ch].re);
+    edelay_rot[ch].count = EDELAY_RESYNC - 1;
+  }
+  edelay_rot[ch].freq = frequency;
+  s = edelay_rot[ch].im;
+  c = edelay_rot[ch].re;
+  float real = data[0];
+  float imag = data[1];
+  data[0] = real * c - imag * s;
+  data[1] = imag * c + real * s;
+}
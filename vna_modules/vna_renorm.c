@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019-2026, Dmitry (DiSlord) dislordlive@gmail.com
+ * All rights reserved.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * The software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Radio; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+//=====================================================================================================
+// Port Z renormalization: convert S parameters measured relative to calibration load R0 (cal_load_r)
+// to complex port 1 impedance Zr = R + jX (power waves definition), port 2 stay at R0
+//   Z    = R0 * (1 + S11) / (1 - S11)
+//   S11' = (Z - Zr*) / (Z + Zr) = (A * S11 + B) / (C * S11 + 1)
+//   S21' = b2 / a1'             =  K * S21  / (C * S11 + 1)
+// A = (R0 + Zr*) / (R0 + Zr), B = (R0 - Zr*) / (R0 + Zr), C = (R0 - Zr) / (R0 + Zr), K = 2 * sqrt(R0 * R) / (R0 + Zr)
+// Coefficients depend only from R0 and Zr, so calculated once on change, every point need one Mobius transform
+//=====================================================================================================
+static struct {
+  float r0, r, x;            // impedances used for coefficients calculation
+  float a[2], b[2], c[2], k[2];
+} renorm;
+
+// out = (re + j*im) * v
+static void renorm_cmul(float re, float im, const float v[2], float out[2]) {
+  out[0] = re * v[0] - im * v[1];
+  out[1] = re * v[1] + im * v[0];
+}
+
+// Check and recalculate coefficients (if port or calibration impedance changed)
+static void renorm_update(void) {
+  float r0 = cal_load_r, r = current_props._portz, x = current_props._portz_x;
+  if (renorm.r0 == r0 && renorm.r == r && renorm.x == x) return;
+  renorm.r0 = r0;
+  renorm.r  = r;
+  renorm.x  = x;
+  // inv = 1 / (R0 + Zr)
+  float l = (r0 + r) * (r0 + r) + x * x;
+  float inv[2] = {(r0 + r) / l, -x / l};
+  renorm_cmul(r0 + r, -x, inv, renorm.a);
+  renorm_cmul(r0 - r,  x, inv, renorm.b);
+  renorm_cmul(r0 - r, -x, inv, renorm.c);
+  renorm_cmul(2.0f * vna_sqrtf(r0 * r), 0.0f, inv, renorm.k);
+}
+
+static void apply_renormalization(float data[4], uint16_t mask) {
+  float s[2] = {0.0f, 0.0f}, d[2];
+  if (mask & SWEEP_CH0_MEASURE) {s[0] = data[0]; s[1] = data[1];}
+  // d = 1 / (C * S11 + 1)
+  renorm_cmul(s[0], s[1], renorm.c, d);
+  d[0]+= 1.0f;
+  float l = 1.0f / (d[0] * d[0] + d[1] * d[1]);
+  d[0]*= l; d[1]*=-l;
+  if (mask & SWEEP_CH0_MEASURE) {
+    float n[2];
+    renorm_cmul(s[0], s[1], renorm.a, n);
+    renorm_cmul(n[0] + renorm.b[0], n[1] + renorm.b[1], d, &data[0]);
+  }
+  if (mask & SWEEP_CH1_MEASURE) {
+    float k[2];
+    renorm_cmul(renorm.k[0], renorm.k[1], d, k);
+    renorm_cmul(data[2], data[3], k, &data[2]);
+  }
+}